@@ -1,18 +1,37 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_GOOGLE_include_directive : enable
+#extension GL_KHR_shader_subgroup_arithmetic : enable
 
 layout (constant_id = 0) const uint TILE_SIZE = 0;
-layout (constant_id = 1) const float Y_SLICES = 0.0;
+layout (constant_id = 2) const bool RECONSTRUCT_POSITION = false;
+layout (constant_id = 3) const bool SCALARIZE = false; // walk clusters of subgroup one by one in uniform control flow
+
+#define CHUNK_SIZE 192 // light chunk of lightculling.comp
 
 // --- structs ---
 #include "structs.inl"
 
 // --- layouts ---
-layout(std430, set = 1, binding = 0) buffer readonly PointLights
+layout(std430, set = 1, binding = 10) buffer readonly LightVolumes
+{
+	uvec2 lightVolumes[];
+};
+
+layout(std430, set = 1, binding = 11) buffer readonly LightIntensities
+{
+	uvec2 lightIntensities[];
+};
+
+layout(std430, set = 1, binding = 12) buffer readonly LightSpots
 {
-	Light lights[];
-} pointLights;
+	uvec2 lightSpots[];
+};
+
+layout(std430, set = 1, binding = 13) buffer readonly NodeLights
+{
+	NodeLight nodeLights[];
+};
 
 layout(std430, set = 1, binding = 1) buffer readonly LightsOut
 {
@@ -20,10 +39,6 @@ layout(std430, set = 1, binding = 1) buffer readonly LightsOut
 	uint data[];
 } lightsOut;
 
-layout(set = 1, binding = 3) uniform sampler2D samplerPosition;
-layout(set = 1, binding = 4) uniform sampler2D samplerAlbedo;
-layout(set = 1, binding = 5) uniform sampler2D samplerNormal;
-layout(set = 1, binding = 6) uniform sampler2D samplerDepth;
 
 layout(std430, set = 1, binding = 7) buffer readonly PageTable
 {
@@ -42,20 +57,70 @@ layout(std430, set = 1, binding = 8) buffer readonly PagePool
 layout(location = 0) in vec2 inUV;
 layout(location = 0) out vec4 outFragcolor;
 
+#include "gbuffer_input.inl"
+
 #include "pt_utils.comp"
 
+#include "heatmap.inl"
+
+#include "spot_light.inl"
+
+#include "light_packing.inl"
+
+#include "diffuse_resolution.inl"
+
+Light loadLight(uint index)
+{
+#ifdef LIGHT_LOD
+	if ((index & AGGREGATE_LIGHT) != 0)
+		return unpackAggregateLight(nodeLights[index & ~AGGREGATE_LIGHT]);
+#endif
+
+	Light light = unpackLight(lightVolumes[index], lightIntensities[index]);
+#ifdef SPOT_LIGHTS
+	unpackLightSpot(lightSpots[index], light.direction, light.cosAngle);
+#endif
+	return light;
+}
+
+
+vec3 shade(Light light, vec3 fragPos, vec3 normal, vec3 albedo, float specStrength)
+{
+	vec3 L = light.position - fragPos;
+	vec3 V = normalize(-fragPos);
+	vec3 N = normalize(normal);
+
+	// Attenuation
+	float atten = clamp(1.0 - pow(length(L), 2.0) / pow(light.radius, 2.0), 0.0, 1.0);
+	L = normalize(L);
+
+	atten *= spotAttenuation(L, light.direction, light.cosAngle);
+
+	// Diffuse part
+	vec3 diff = albedo * max(0.0, dot(N, L)) * atten * light.intensity;
+
+	// Specular part
+	vec3 H = normalize(L + V);
+	float spec = max(0.0, dot(N, H));
+	vec3 specular = vec3(specStrength * pow(spec, 16.0)) * atten * light.intensity;
+
+	return lightingTerms(diff, specular);
+}
 
 void main() 
 {
+	uvec2 pixel = shadedPixel();
+
 	// Get G-Buffer values
-	vec3 fragPos = texture(samplerPosition, inUV).rgb;
-	vec4 albedo = texture(samplerAlbedo, inUV);
-	vec3 normal = octToFloat32x3(texture(samplerNormal, inUV).rg);
-	float specStrength = texture(samplerPosition, inUV).a;
-
-	float depth = getViewDepth(texture(samplerDepth, inUV).r);
-	uint k = uint(log(depth / NEAR) / Y_SLICES);
-	uvec3 key = uvec3(uvec2(gl_FragCoord.xy) / uvec2(TILE_SIZE, TILE_SIZE), k);
+	float projDepth = loadDepth().r;
+	vec3 fragPos = RECONSTRUCT_POSITION ? reconstructPosition(gbufferUV, projDepth) : loadPosition().rgb;
+	vec4 albedo = loadAlbedo();
+	vec3 normal = octToFloat32x3(loadNormal().rg);
+	float specStrength = albedo.a;
+
+	float depth = getViewDepth(projDepth);
+	uint k = getDepthSlice(depth);
+	uvec3 key = uvec3(pixel / uvec2(TILE_SIZE, TILE_SIZE), k);
 	uint address = addressTranslate(packKey(key));
 	uint index = pool.data[address];
 	
@@ -63,39 +128,41 @@ void main()
 	// #define ambient 0.03
 	#define ambient 0.25
 
-	vec3 fragcolor = albedo.rgb * ambient;
+	vec3 fragcolor = albedo.rgb * diffuseIrradiance(ambient, fragPos, normal);
 
-	uint indirectCount = lightsOut.data[index];
-	for (uint ii = 0; ii < indirectCount; ii++)
+	// scalarized loop visits every unique cluster of subgroup once, lights are loaded uniformly
+	// and only lanes in visited cluster keep the contribution
+	bool pending = true;
+	while (true)
 	{
-		uint stop = (ii == indirectCount - 1) ? lightsOut.data[index + 1] : 192;
-		uint offset = lightsOut.data[index + ii + 2];
-
-		for (uint i = 0; i < stop; i++)
-		{
-			uint lightIndex = lightsOut.data[offset + i];
+		uint current = SCALARIZE ? subgroupMin(pending ? index : 0xFFFFFFFF) : index;
+		if (current == 0xFFFFFFFF)
+			break;
 
-			Light light = pointLights.lights[lightIndex];
+		bool inCluster = current == index;
 
-			vec3 L = light.position - fragPos;
-			vec3 V = normalize(-fragPos);
-			vec3 N = normalize(normal);
-
-			// Attenuation
-			float atten = clamp(1.0 - pow(length(L), 2.0) / pow(light.radius, 2.0), 0.0, 1.0);
-			L = normalize(L);
-
-			// Diffuse part
-			vec3 diff = albedo.rgb * max(0.0, dot(N, L)) * atten * light.intensity;
-
-			// Specular part
-			vec3 H = normalize(L + V);
-			float spec = max(0.0, dot(N, H));
-			vec3 specular = vec3(specStrength * pow(spec, 16.0)) * atten * light.intensity;
-
-			fragcolor += specular + diff;
+		uint indirectCount = lightsOut.data[current];
+		for (uint ii = 0; ii < indirectCount; ii++)
+		{
+			uint stop = (ii == indirectCount - 1) ? lightsOut.data[current + 1] : CHUNK_SIZE;
+			uint offset = lightsOut.data[current + ii + 2];
+
+			for (uint i = 0; i < stop; i++)
+			{
+				vec3 contribution = shade(loadLight(lightsOut.data[offset + i]), fragPos, normal, albedo.rgb, specStrength);
+				fragcolor += inCluster ? contribution : vec3(0.0);
+			}
 		}
+
+		pending = pending && !inCluster;
+		if (!SCALARIZE)
+			break;
 	}
 
- 	outFragcolor = vec4(fragcolor, 1.0);	
+#ifdef HEATMAP
+	uint indirectCount = lightsOut.data[index];
+	fragcolor = heatmap(indirectCount > 0 ? (indirectCount - 1) * CHUNK_SIZE + lightsOut.data[index + 1] : 0);
+#endif
+
+ 	writeColor(fragcolor, fragPos);
 }
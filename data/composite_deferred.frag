@@ -1,7 +1,9 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
 
 layout (constant_id = 0) const uint TILE_SIZE = 0;
+layout (constant_id = 2) const bool RECONSTRUCT_POSITION = false;
 
 // --- structs ---
 struct Light
@@ -10,6 +12,8 @@ struct Light
 	float radius;
 	vec3 intensity;
 	float pad;
+	vec3 direction; // spot axis
+	float cosAngle; // cosine of spot half angle, below -1 for point lights
 };
 
 // --- layouts ---
@@ -27,13 +31,16 @@ layout(std430, set = 1, binding = 0) buffer readonly PointLights
 	Light lights[];
 } pointLights;
 
-layout(set = 1, binding = 3) uniform sampler2D samplerPosition;
-layout(set = 1, binding = 4) uniform sampler2D samplerAlbedo;
-layout(set = 1, binding = 5) uniform sampler2D samplerNormal;
 
 layout(location = 0) in vec2 inUV;
 layout(location = 0) out vec4 outFragcolor;
 
+#include "gbuffer_input.inl"
+
+#include "heatmap.inl"
+
+#include "spot_light.inl"
+
 layout(push_constant) uniform pushConstants 
 {
 	uint lightCount;
@@ -56,23 +63,35 @@ vec3 octToFloat32x3(vec2 e)
 	return normalize(v);
 }
 
+// View space position from depth buffer
+vec3 reconstructPosition(vec2 uv, float projDepth)
+{
+	vec4 position = camera.invProj * vec4(uv * 2.0 - 1.0, projDepth, 1.0);
+	return position.xyz / max(position.w, 1e-7); // background of reversed depth lies at infinity
+}
+
+#include "diffuse_resolution.inl"
+
 void main() 
 {
+	shadedPixel(); // no tiles, only selects G-buffer sample
+
 	// Get G-Buffer values
-	vec3 fragPos = texture(samplerPosition, inUV).rgb;
-	vec4 albedo = texture(samplerAlbedo, inUV);
-	vec3 normal = octToFloat32x3(texture(samplerNormal, inUV).rg);
-	float specStrength = texture(samplerPosition, inUV).a;
+	vec3 fragPos = RECONSTRUCT_POSITION ? reconstructPosition(gbufferUV, loadDepth().r) : loadPosition().rgb;
+	vec4 albedo = loadAlbedo();
+	vec3 normal = octToFloat32x3(loadNormal().rg);
+	float specStrength = albedo.a;
 
 	// Ambient part
 	#define ambient 0.25
 	
-	vec3 fragcolor = albedo.rgb * ambient;
+	vec3 fragcolor = albedo.rgb * diffuseIrradiance(ambient, fragPos, normalize(normal));
 
 	for (uint i = 0; i < lightCount; i++)
 	{
 		Light light = pointLights.lights[i];
 		light.position = (camera.view * vec4(light.position, 1.0)).xyz;
+		light.direction = mat3(camera.view) * light.direction;
 
 		vec3 L = light.position - fragPos;
 		vec3 V = normalize(-fragPos);
@@ -82,6 +101,8 @@ void main()
 		float atten = clamp(1.0 - pow(length(L), 2.0) / pow(light.radius, 2.0), 0.0, 1.0);
 		L = normalize(L);
 
+		atten *= spotAttenuation(L, light.direction, light.cosAngle);
+
 		// Diffuse part
 		vec3 diff = albedo.rgb * max(0.0, dot(N, L)) * atten * light.intensity;
 
@@ -90,8 +111,12 @@ void main()
 		float spec = max(0.0, dot(N, H));
 		vec3 specular = vec3(specStrength * pow(spec, 16.0)) * atten * light.intensity;
 
-		fragcolor += specular + diff;
+		fragcolor += lightingTerms(diff, specular);
 	}
 
- 	outFragcolor = vec4(fragcolor, 1.0);	
+#ifdef HEATMAP
+	fragcolor = heatmap(lightCount);
+#endif
+
+ 	writeColor(fragcolor, fragPos);
 }
\ No newline at end of file
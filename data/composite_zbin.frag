@@ -0,0 +1,181 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+layout (constant_id = 0) const uint TILE_SIZE = 0;
+layout (constant_id = 2) const bool RECONSTRUCT_POSITION = false;
+
+#define NUM_BINS 1024 // has to match zbin.comp
+
+// --- structs ---
+#include "structs.inl"
+
+// --- layouts ---
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+	mat4 view;
+	mat4 proj;
+	mat4 invProj;
+	vec3 position;
+	uvec2 screenSize;
+	float zNear;
+	float zFar;
+	float sliceNear;
+	float sliceScale;
+	uint keyBitsX;
+	uint keyBitsY;
+	uint pageSizePower;
+	vec3 lightBoundsMin; // view space bounds of quantized light positions
+	vec3 lightBoundsExtent;
+} camera;
+
+layout(std430, set = 1, binding = 10) buffer readonly LightVolumes
+{
+	uvec2 lightVolumes[]; // view space after sorting
+};
+
+layout(std430, set = 1, binding = 11) buffer readonly LightIntensities
+{
+	uvec2 lightIntensities[];
+};
+
+layout(std430, set = 1, binding = 12) buffer readonly LightSpots
+{
+	uvec2 lightSpots[];
+};
+
+layout(std430, set = 1, binding = 1) buffer readonly SortedKeys
+{
+	Key keys[];
+};
+
+layout(std430, set = 3, binding = 0) buffer readonly Bins
+{
+	uint binMin[NUM_BINS];
+	uint binMax[NUM_BINS];
+};
+
+layout(std430, set = 3, binding = 1) buffer readonly TileMasks
+{
+	uint tileMasks[];
+};
+
+layout(push_constant) uniform pushConstants
+{
+	uint wordsPerTile;
+};
+
+layout(location = 0) in vec2 inUV;
+layout(location = 0) out vec4 outFragcolor;
+
+#include "gbuffer_input.inl"
+
+#include "heatmap.inl"
+
+#include "spot_light.inl"
+
+#include "light_packing.inl"
+
+Light loadLight(uint index)
+{
+	Light light = unpackLight(lightVolumes[index], lightIntensities[index]);
+#ifdef SPOT_LIGHTS
+	unpackLightSpot(lightSpots[index], light.direction, light.cosAngle);
+#endif
+	return light;
+}
+
+// Returns ±1
+vec2 signNotZero(vec2 v)
+{
+	return vec2((v.x >= 0.0) ? 1.0 : -1.0, (v.y >= 0.0) ? 1.0 : -1.0);
+}
+
+vec3 octToFloat32x3(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+
+	if (v.z < 0)
+		v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+
+	return normalize(v);
+}
+
+// View space position from depth buffer
+vec3 reconstructPosition(vec2 uv, float projDepth)
+{
+	vec4 position = camera.invProj * vec4(uv * 2.0 - 1.0, projDepth, 1.0);
+	return position.xyz / max(position.w, 1e-7); // background of reversed depth lies at infinity
+}
+
+#include "diffuse_resolution.inl"
+
+void main()
+{
+	uvec2 pixel = shadedPixel();
+
+	// Get G-Buffer values
+	vec3 fragPos = RECONSTRUCT_POSITION ? reconstructPosition(gbufferUV, loadDepth().r) : loadPosition().rgb;
+	vec4 albedo = loadAlbedo();
+	vec3 N = normalize(octToFloat32x3(loadNormal().rg));
+	vec3 V = normalize(-fragPos);
+	float specStrength = albedo.a;
+
+	// Ambient part
+	#define ambient 0.25
+
+	vec3 fragcolor = albedo.rgb * diffuseIrradiance(ambient, fragPos, N);
+	uint lightCount = 0;
+
+	// range of sorted lights from depth bin, intersected with tile mask
+	uint bin = uint(clamp((-fragPos.z - camera.zNear) / (camera.zFar - camera.zNear), 0.0, 1.0) * (NUM_BINS - 1));
+	uint first = binMin[bin];
+	uint last = binMax[bin];
+
+	uvec2 tileID = pixel / uvec2(TILE_SIZE, TILE_SIZE);
+	uint tileOffset = (tileID.y * ((camera.screenSize.x - 1) / TILE_SIZE + 1) + tileID.x) * wordsPerTile;
+
+	for (uint word = first / 32; first <= last && word <= last / 32; word++)
+	{
+		uint mask = tileMasks[tileOffset + word];
+
+		if (word == first / 32)
+			mask &= ~0u << (first % 32);
+		if (word == last / 32)
+			mask &= ~0u >> (31 - last % 32);
+
+		lightCount += bitCount(mask);
+
+		while (mask != 0)
+		{
+			uint bit = findLSB(mask);
+			mask &= mask - 1;
+
+			Light light = loadLight(keys[word * 32 + bit].lightIndex);
+
+			vec3 L = light.position - fragPos;
+
+			// Attenuation
+			float atten = clamp(1.0 - pow(length(L), 2.0) / pow(light.radius, 2.0), 0.0, 1.0);
+			L = normalize(L);
+
+			atten *= spotAttenuation(L, light.direction, light.cosAngle);
+
+			// Diffuse part
+			vec3 diff = albedo.rgb * max(0.0, dot(N, L)) * atten * light.intensity;
+
+			// Specular part
+			vec3 H = normalize(L + V);
+			float spec = max(0.0, dot(N, H));
+			vec3 specular = vec3(specStrength * pow(spec, 16.0)) * atten * light.intensity;
+
+			fragcolor += lightingTerms(diff, specular);
+		}
+	}
+
+#ifdef HEATMAP
+	fragcolor = heatmap(lightCount);
+#endif
+
+ 	writeColor(fragcolor, fragPos);
+}
@@ -2,6 +2,8 @@
 
 #extension GL_ARB_separate_shader_objects : enable
 
+layout (constant_id = 2) const bool RECONSTRUCT_POSITION = false;
+
 layout(set = 0, binding = 0) uniform DebugUBO
 {
 	uint index;
@@ -13,6 +15,15 @@ layout(set = 1, binding = 4) uniform sampler2D samplerAlbedo;
 layout(set = 1, binding = 5) uniform sampler2D samplerNormal;
 layout(set = 1, binding = 6) uniform sampler2D samplerDepth;
 
+layout(set = 2, binding = 0) uniform CameraUBO
+{
+	mat4 view;
+	mat4 proj;
+	mat4 invProj;
+	vec3 position;
+	uvec2 screenSize;
+} camera;
+
 layout(location = 0) in vec2 inUV;
 
 layout(location = 0) out vec4 outFragcolor;
@@ -25,8 +36,14 @@ void main()
 
 	ret[0] = texture(samplerAlbedo, inUV).rgb;
 	ret[1] = vec3(texture(samplerNormal, inUV).rg, 0);
-	ret[2] = vec3(texture(samplerposition, inUV).a);
+	ret[2] = vec3(texture(samplerAlbedo, inUV).a);
 	ret[3] = texture(samplerposition, inUV).rgb;
+
+	if (RECONSTRUCT_POSITION)
+	{
+		vec4 position = camera.invProj * vec4(inUV * 2.0 - 1.0, texture(samplerDepth, inUV).r, 1.0);
+		ret[3] = position.xyz / max(position.w, 1e-7); // background of reversed depth lies at infinity
+	}
 	ret[4] = vec3(texture(samplerDepth, inUV).r);
 	
  	outFragcolor = vec4(ret[state.index - 1], 1.0);	
@@ -0,0 +1,48 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+	mat4 view;
+	mat4 proj;
+	mat4 invProj;
+	vec3 position;
+	uvec2 screenSize;
+} camera;
+
+layout(set = 1, binding = 0) uniform Model
+{
+	mat4 model;
+} transform;
+
+struct PartBounds
+{
+	vec4 min;
+	vec4 extent;
+};
+
+layout(std430, set = 2, binding = 2) buffer readonly Bounds
+{
+	PartBounds bounds[];
+};
+
+#ifdef PACKED_VERTICES
+layout(location = 0) in uvec4 inPosition; // xyz quantized to part bounds, w unused
+#else
+layout(location = 0) in vec3 inPosition;
+#endif
+
+invariant gl_Position; // matches G-buffer vertex shaders, tested with equal
+
+void main()
+{
+#ifdef PACKED_VERTICES
+	PartBounds partBounds = bounds[gl_InstanceIndex]; // first instance of indirect draw is part index
+	vec3 position = partBounds.min.xyz + vec3(inPosition.xyz) * (1.0 / 65535.0) * partBounds.extent.xyz;
+#else
+	vec3 position = inPosition;
+#endif
+
+	mat4 viewModel = camera.view * transform.model;
+	gl_Position = camera.proj * viewModel * vec4(position, 1.0);
+}
@@ -0,0 +1,122 @@
+// Diffuse lighting at reduced resolution. Diffuse pass shades one representative G-buffer sample per block
+// of DIFFUSE_SCALE pixels, full resolution composition adds specular to diffuse upsampled by joint bilateral filter.
+// Requires camera, samplerDepth, loadNormal, octToFloat32x3 and outFragcolor
+
+layout (constant_id = 4) const uint DIFFUSE_SCALE = 1;
+
+#ifdef DIFFUSE_ONLY
+layout(location = 1) out vec2 outDiffuseNormal; // octahedral normal of shaded sample
+
+// irradiance is shaded, albedo is applied at full resolution
+#undef loadAlbedo
+#define loadAlbedo() vec4(1.0, 1.0, 1.0, 0.0)
+
+const bool SHADE_DIFFUSE = true;
+const bool SHADE_SPECULAR = false;
+#elif defined(UPSAMPLED_DIFFUSE)
+layout(set = 1, binding = 14) uniform sampler2D samplerDiffuse; // irradiance, view depth in alpha
+layout(set = 1, binding = 15) uniform sampler2D samplerDiffuseNormal;
+
+const bool SHADE_DIFFUSE = false;
+const bool SHADE_SPECULAR = true;
+#else
+const bool SHADE_DIFFUSE = true;
+const bool SHADE_SPECULAR = true;
+#endif
+
+// Full resolution pixel whose G-buffer sample is shaded. Blocks alternate nearest and farthest depth
+// in checkerboard, so both sides of depth edges keep samples to upsample from
+uvec2 shadedPixel()
+{
+#ifdef DIFFUSE_ONLY
+	uvec2 block = uvec2(gl_FragCoord.xy);
+	uvec2 origin = block * DIFFUSE_SCALE;
+	bool nearest = ((block.x + block.y) & 1u) == 0u;
+
+	uvec2 pixel = min(origin, camera.screenSize - 1u);
+	float representative = texelFetch(samplerDepth, ivec2(pixel), 0).r;
+
+	for (uint i = 1; i < DIFFUSE_SCALE * DIFFUSE_SCALE; i++)
+	{
+		uvec2 candidate = min(origin + uvec2(i % DIFFUSE_SCALE, i / DIFFUSE_SCALE), camera.screenSize - 1u);
+		float depth = texelFetch(samplerDepth, ivec2(candidate), 0).r;
+
+		if (nearest ? depth < representative : depth > representative)
+		{
+			representative = depth;
+			pixel = candidate;
+		}
+	}
+
+	gbufferUV = (vec2(pixel) + 0.5) / vec2(camera.screenSize);
+	return pixel;
+#else
+	return uvec2(gl_FragCoord.xy);
+#endif
+}
+
+#ifdef UPSAMPLED_DIFFUSE
+// bilinear weights of four nearest diffuse samples, scaled by similarity of view depth and normal
+vec3 upsampleDiffuse(vec3 fragPos, vec3 N)
+{
+	ivec2 size = ivec2((camera.screenSize - 1u) / DIFFUSE_SCALE + 1u); // rendered part of diffuse image
+	vec2 position = gl_FragCoord.xy / float(DIFFUSE_SCALE) - 0.5;
+	ivec2 base = ivec2(floor(position));
+	vec2 fraction = position - vec2(base);
+
+	vec3 sum = vec3(0.0);
+	float weightSum = 0.0;
+	vec3 closest = vec3(0.0);
+	float closestDistance = 1e30;
+
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(base + offset, ivec2(0), size - 1);
+
+		vec4 diffuse = texelFetch(samplerDiffuse, texel, 0);
+		vec3 normal = octToFloat32x3(texelFetch(samplerDiffuseNormal, texel, 0).rg);
+
+		float depthDistance = abs(diffuse.a + fragPos.z) / max(-fragPos.z, 1e-4); // relative to view depth of pixel
+		vec2 bilinear = mix(1.0 - fraction, fraction, vec2(offset));
+		float weight = bilinear.x * bilinear.y * exp(-32.0 * depthDistance) * pow(max(dot(N, normal), 0.0), 8.0);
+
+		sum += diffuse.rgb * weight;
+		weightSum += weight;
+
+		// no similar sample around, nearest surface in depth is the best guess
+		if (depthDistance < closestDistance)
+		{
+			closestDistance = depthDistance;
+			closest = diffuse.rgb;
+		}
+	}
+
+	return weightSum > 1e-4 ? sum / weightSum : closest;
+}
+#endif
+
+// ambient, or upsampled diffuse lighting which already contains it
+vec3 diffuseIrradiance(float ambientFactor, vec3 fragPos, vec3 N)
+{
+#ifdef UPSAMPLED_DIFFUSE
+	return upsampleDiffuse(fragPos, N);
+#else
+	return vec3(ambientFactor);
+#endif
+}
+
+vec3 lightingTerms(vec3 diffuse, vec3 specular)
+{
+	return (SHADE_DIFFUSE ? diffuse : vec3(0.0)) + (SHADE_SPECULAR ? specular : vec3(0.0));
+}
+
+void writeColor(vec3 color, vec3 fragPos)
+{
+#ifdef DIFFUSE_ONLY
+	outFragcolor = vec4(color, -fragPos.z);
+	outDiffuseNormal = loadNormal().rg;
+#else
+	outFragcolor = vec4(color, 1.0);
+#endif
+}
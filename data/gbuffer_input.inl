@@ -0,0 +1,31 @@
+// G-buffer access, sampled textures or input attachments of merged render pass
+#ifdef SUBPASS_INPUT
+layout(input_attachment_index = 0, set = 2, binding = 0) uniform subpassInput inputPosition;
+layout(input_attachment_index = 1, set = 2, binding = 1) uniform subpassInput inputAlbedo;
+layout(input_attachment_index = 2, set = 2, binding = 2) uniform subpassInput inputNormal;
+layout(input_attachment_index = 3, set = 2, binding = 3) uniform subpassInput inputDepth;
+
+#define loadPosition() subpassLoad(inputPosition)
+#define loadAlbedo() subpassLoad(inputAlbedo)
+#define loadNormal() subpassLoad(inputNormal)
+#define loadDepth() subpassLoad(inputDepth)
+#else
+layout(set = 1, binding = 3) uniform sampler2D samplerPosition;
+layout(set = 1, binding = 4) uniform sampler2D samplerAlbedo;
+layout(set = 1, binding = 5) uniform sampler2D samplerNormal;
+layout(set = 1, binding = 6) uniform sampler2D samplerDepth;
+
+// fetched by pixel, attachments are larger than rendered area under dynamic resolution
+#define gbufferPixel ivec2(gbufferUV * vec2(camera.screenSize))
+#define loadPosition() texelFetch(samplerPosition, gbufferPixel, 0)
+#define loadAlbedo() texelFetch(samplerAlbedo, gbufferPixel, 0)
+#define loadNormal() texelFetch(samplerNormal, gbufferPixel, 0)
+#define loadDepth() texelFetch(samplerDepth, gbufferPixel, 0)
+#endif
+
+// reduced resolution diffuse pass reads representative sample of its block, chosen by shadedPixel
+#ifdef DIFFUSE_ONLY
+vec2 gbufferUV;
+#else
+#define gbufferUV inUV
+#endif
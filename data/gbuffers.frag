@@ -1,25 +1,34 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(set = 2, binding = 0) uniform MaterialUBO
+#ifndef MAX_MATERIAL_TEXTURES // clamped to device limits by renderer
+#define MAX_MATERIAL_TEXTURES 1024
+#endif
+
+struct Material
+{
+	uint albedoMap; // 0 means no map
+	uint normalMap;
+	uint specularMap;
+	uint padding;
+};
+
+layout(std430, set = 2, binding = 0) buffer readonly Materials
 {
-	int hasAlbedoMap;
-	int hasNormalMap;
-	int hasSpecularMap;
-} material;
+	Material materials[];
+};
 
-layout(set = 2, binding = 1) uniform sampler2D albedoSampler;
-layout(set = 2, binding = 2) uniform sampler2D normalSampler;
-layout(set = 2, binding = 3) uniform sampler2D specularSampler;
+layout(set = 2, binding = 1) uniform sampler2D textures[MAX_MATERIAL_TEXTURES];
 
 layout(location = 0) in vec3 worldPos;
 layout(location = 1) in vec2 texCoord;
 layout(location = 2) in vec3 color;
 layout(location = 3) in vec3 normal;
-layout(location = 4) in vec3 tangent;
+layout(location = 4) in vec4 tangent; // w is bitangent sign
 layout(location = 5) in vec3 bitangent;
+layout(location = 6) flat in uint materialIndex;
 
-layout(location = 0) out vec4 outPosition;
+layout(location = 0) out vec4 outPosition; // unused attachment when position is reconstructed
 layout(location = 1) out vec4 outColor;
 layout(location = 2) out vec2 outNormal;
 
@@ -46,22 +55,26 @@ void main()
 	
 	outColor = vec4(color, 1.0);
 
-	if (material.hasAlbedoMap > 0)
-		outColor = texture(albedoSampler, texCoord);
+	// index is uniform within one draw
+	Material material = materials[materialIndex];
+
+	if (material.albedoMap > 0)
+		outColor.rgb = texture(textures[material.albedoMap], texCoord).rgb;
 
-	if (material.hasSpecularMap > 0)
-		specular = texture(specularSampler, texCoord).r;
+	if (material.specularMap > 0)
+		specular = texture(textures[material.specularMap], texCoord).r;
 
-	if (material.hasNormalMap > 0) 
-		normalTex = texture(normalSampler, texCoord).xyz;
+	if (material.normalMap > 0) 
+		normalTex = texture(textures[material.normalMap], texCoord).xyz;
 
 	vec3 N = normalize(normal);
-	vec3 T = normalize(tangent);
-	vec3 B = cross(N, T);
+	vec3 T = normalize(tangent.xyz);
+	vec3 B = cross(N, T) * tangent.w;
 
 
 	mat3 TBN = mat3(T, B, N);
 
 	outNormal = float32x3_to_oct(TBN * normalize(normalTex * 2.0 - 1.0));
-	outPosition = vec4(worldPos, specular);
+	outColor.a = specular; // alpha is unused, position target may be dropped
+	outPosition = vec4(worldPos, 1.0);
 }
\ No newline at end of file
@@ -25,13 +25,11 @@ layout(location = 0) out vec3 outPosition;
 layout(location = 1) out vec2 outTexCoord;
 layout(location = 2) out vec3 outColor;
 layout(location = 3) out vec3 outNormal;
-layout(location = 4) out vec3 outTangent;
+layout(location = 4) out vec4 outTangent; // w is bitangent sign
 layout(location = 5) out vec3 outBitangent;
+layout(location = 6) flat out uint outMaterialIndex;
 
-out gl_PerVertex 
-{
-    vec4 gl_Position;
-};
+invariant gl_Position; // depth prepass computes position the same way, tested with equal
 
 void main() 
 {
@@ -42,6 +40,7 @@ void main()
 
 	outColor = inColor;
 	outTexCoord = inTexCoord;
+	outMaterialIndex = gl_InstanceIndex; // first instance of indirect draw is part index
 
 	vec3 N = invTransModel * inNormal;
 	vec3 T = invTransModel * inTangent;
@@ -49,7 +48,7 @@ void main()
 	// vec3 B = cross(N, T);
 
 	outNormal = N;
-	outTangent = T;
+	outTangent = vec4(T, 1.0);
 	// outBitangent = B;
 
 	outPosition = (viewModel * vec4(inPosition, 1.0)).rgb;
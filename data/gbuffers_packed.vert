@@ -0,0 +1,81 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+	mat4 view;
+	mat4 proj;
+	mat4 invProj;
+	vec3 position;
+	uvec2 screenSize;
+} camera;
+
+layout(set = 1, binding = 0) uniform Model
+{
+	mat4 model;
+} transform;
+
+struct PartBounds
+{
+	vec4 min;
+	vec4 extent;
+};
+
+layout(std430, set = 2, binding = 2) buffer readonly Bounds
+{
+	PartBounds bounds[];
+};
+
+layout(location = 0) in uvec4 inPosition; // xyz quantized to part bounds, w bitangent sign and RGB555 color
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in vec4 inNormalTangent; // octahedral encoded
+
+layout(location = 0) out vec3 outPosition;
+layout(location = 1) out vec2 outTexCoord;
+layout(location = 2) out vec3 outColor;
+layout(location = 3) out vec3 outNormal;
+layout(location = 4) out vec4 outTangent; // w is bitangent sign
+layout(location = 5) out vec3 outBitangent;
+layout(location = 6) flat out uint outMaterialIndex;
+
+invariant gl_Position; // depth prepass computes position the same way, tested with equal
+
+// Returns ±1
+vec2 signNotZero(vec2 v) 
+{
+	return vec2((v.x >= 0.0) ? 1.0 : -1.0, (v.y >= 0.0) ? 1.0 : -1.0);
+}
+
+vec3 octToFloat32x3(vec2 e) 
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+
+	if (v.z < 0) 
+		v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+
+	return normalize(v);
+}
+
+void main() 
+{
+	PartBounds partBounds = bounds[gl_InstanceIndex]; // first instance of indirect draw is part index
+	vec3 position = partBounds.min.xyz + vec3(inPosition.xyz) * (1.0 / 65535.0) * partBounds.extent.xyz;
+
+	mat4 viewModel = camera.view * transform.model;
+	mat3 invTransModel = transpose(inverse(mat3(viewModel)));
+	
+	gl_Position = camera.proj * viewModel * vec4(position, 1.0);
+
+	outColor = vec3((inPosition.w >> 10) & 0x1F, (inPosition.w >> 5) & 0x1F, inPosition.w & 0x1F) * (1.0 / 31.0);
+	outTexCoord = inTexCoord;
+	outMaterialIndex = gl_InstanceIndex;
+
+	vec3 N = invTransModel * octToFloat32x3(inNormalTangent.xy);
+	vec3 T = invTransModel * octToFloat32x3(inNormalTangent.zw);
+	T -=  dot(T, N) * N;
+
+	outNormal = N;
+	outTangent = vec4(T, (inPosition.w & 0x8000) != 0 ? -1.0 : 1.0);
+
+	outPosition = (viewModel * vec4(position, 1.0)).rgb;
+}
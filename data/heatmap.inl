@@ -0,0 +1,12 @@
+// Debug view of lights evaluated per pixel, compiled into composition shaders with HEATMAP define
+#define HEATMAP_MAX_LIGHTS 128.0
+
+// Black for no lights, then blue through green to red, saturates at HEATMAP_MAX_LIGHTS
+vec3 heatmap(uint lightCount)
+{
+	if (lightCount == 0)
+		return vec3(0.0);
+
+	float t = clamp(float(lightCount) / HEATMAP_MAX_LIGHTS, 0.0, 1.0);
+	return t < 0.5 ? mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), t * 2.0) : mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), t * 2.0 - 1.0);
+}
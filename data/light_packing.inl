@@ -0,0 +1,76 @@
+// Sorted lights are packed to streams after light sorting. Volumes are all culling reads,
+// 16 bit position inside view space bounds of lights and half radius. Shading adds half intensity.
+// Spot stream with octahedral axis and half cosine of angle is written only when scene has spot lights.
+// Requires camera with lightBoundsMin and lightBoundsExtent
+
+uvec2 packLightVolume(vec3 position, float radius)
+{
+	uvec3 quantized = uvec3(round(clamp((position - camera.lightBoundsMin) / camera.lightBoundsExtent, 0.0, 1.0) * 65535.0));
+
+	// round radius up, so culling stays conservative
+	uint radiusBits = packHalf2x16(vec2(radius, 0.0));
+	if (unpackHalf2x16(radiusBits).x < radius)
+		radiusBits++;
+
+	return uvec2(quantized.x | quantized.y << 16, quantized.z | radiusBits << 16);
+}
+
+// xyz view space position, w radius
+vec4 unpackLightVolume(uvec2 volume)
+{
+	vec3 quantized = vec3(volume.x & 0xFFFFu, volume.x >> 16, volume.y & 0xFFFFu);
+	return vec4(camera.lightBoundsMin + quantized / 65535.0 * camera.lightBoundsExtent, unpackHalf2x16(volume.y >> 16).x);
+}
+
+uvec2 packLightIntensity(vec3 intensity)
+{
+	return uvec2(packHalf2x16(intensity.rg), packHalf2x16(vec2(intensity.b, 0.0)));
+}
+
+vec3 unpackLightIntensity(uvec2 intensity)
+{
+	return vec3(unpackHalf2x16(intensity.x), unpackHalf2x16(intensity.y).x);
+}
+
+uvec2 packLightSpot(vec3 direction, float cosAngle)
+{
+	vec2 oct = direction.xy / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+	if (direction.z < 0.0)
+		oct = (1.0 - abs(oct.yx)) * vec2(oct.x >= 0.0 ? 1.0 : -1.0, oct.y >= 0.0 ? 1.0 : -1.0);
+
+	// round angle up, so culling stays conservative
+	uint cosBits = packHalf2x16(vec2(cosAngle, 0.0));
+	if (unpackHalf2x16(cosBits).x > cosAngle)
+		cosBits = cosAngle > 0.0 ? cosBits - 1u : cosBits + 1u;
+
+	return uvec2(packSnorm2x16(oct), cosBits);
+}
+
+void unpackLightSpot(uvec2 spot, out vec3 direction, out float cosAngle)
+{
+	vec2 oct = unpackSnorm2x16(spot.x);
+	direction = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+	if (direction.z < 0.0)
+		direction.xy = (1.0 - abs(direction.yx)) * vec2(direction.x >= 0.0 ? 1.0 : -1.0, direction.y >= 0.0 ? 1.0 : -1.0);
+
+	direction = normalize(direction);
+	cosAngle = unpackHalf2x16(spot.y).x;
+}
+
+// point light, spot factor of shading stays one
+Light unpackLight(uvec2 volume, uvec2 intensity)
+{
+	vec4 sphere = unpackLightVolume(volume);
+	return Light(sphere.xyz, sphere.w, unpackLightIntensity(intensity), 0u, vec3(0.0, 0.0, -1.0), -2.0);
+}
+
+// light list entries with this bit index node lights of light LOD
+#define AGGREGATE_LIGHT 0x80000000u
+
+// center of light positions, reaches everywhere any merged light does
+Light unpackAggregateLight(NodeLight aggregate)
+{
+	vec3 center = (aggregate.positionMin.xyz + aggregate.positionMax.xyz) * 0.5;
+	float radius = aggregate.positionMin.w + 0.5 * distance(aggregate.positionMin.xyz, aggregate.positionMax.xyz);
+	return Light(center, radius, aggregate.intensity.rgb, 0u, vec3(0.0, 0.0, -1.0), -2.0);
+}
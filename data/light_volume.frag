@@ -0,0 +1,101 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : enable
+
+layout (constant_id = 2) const bool RECONSTRUCT_POSITION = false;
+
+// --- structs ---
+struct Light
+{
+	vec3 position;
+	float radius;
+	vec3 intensity;
+	float pad;
+	vec3 direction; // spot axis
+	float cosAngle; // cosine of spot half angle, below -1 for point lights
+};
+
+// --- layouts ---
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+	mat4 view;
+	mat4 proj;
+	mat4 invProj;
+	vec3 position;
+	uvec2 screenSize;
+} camera;
+
+layout(std430, set = 1, binding = 0) buffer readonly PointLights
+{
+	Light lights[];
+} pointLights;
+
+layout(location = 0) flat in uint inLightIndex;
+layout(location = 0) out vec4 outFragcolor;
+
+vec2 inUV; // G-buffer coordinate of fragment
+
+#include "gbuffer_input.inl"
+
+#include "spot_light.inl"
+
+// Returns ±1
+vec2 signNotZero(vec2 v) 
+{
+	return vec2((v.x >= 0.0) ? 1.0 : -1.0, (v.y >= 0.0) ? 1.0 : -1.0);
+}
+
+vec3 octToFloat32x3(vec2 e) 
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+
+	if (v.z < 0) 
+		v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+
+	return normalize(v);
+}
+
+// View space position from depth buffer
+vec3 reconstructPosition(vec2 uv, float projDepth)
+{
+	vec4 position = camera.invProj * vec4(uv * 2.0 - 1.0, projDepth, 1.0);
+	return position.xyz / position.w;
+}
+
+void main() 
+{
+	inUV = gl_FragCoord.xy / vec2(camera.screenSize);
+
+	Light light = pointLights.lights[inLightIndex];
+	light.position = (camera.view * vec4(light.position, 1.0)).xyz;
+	light.direction = mat3(camera.view) * light.direction;
+
+	// surfaces in front of volume pass depth test of back faces too
+	vec3 fragPos = RECONSTRUCT_POSITION ? reconstructPosition(inUV, loadDepth().r) : loadPosition().rgb;
+	vec3 L = light.position - fragPos;
+	if (dot(L, L) >= light.radius * light.radius)
+		discard;
+
+	// Get G-Buffer values
+	vec4 albedo = loadAlbedo();
+	vec3 N = octToFloat32x3(loadNormal().rg);
+	vec3 V = normalize(-fragPos);
+	float specStrength = albedo.a;
+
+	// Attenuation
+	float atten = clamp(1.0 - pow(length(L), 2.0) / pow(light.radius, 2.0), 0.0, 1.0);
+	L = normalize(L);
+
+	atten *= spotAttenuation(L, light.direction, light.cosAngle);
+
+	// Diffuse part
+	vec3 diff = albedo.rgb * max(0.0, dot(N, L)) * atten * light.intensity;
+
+	// Specular part
+	vec3 H = normalize(L + V);
+	float spec = max(0.0, dot(N, H));
+	vec3 specular = vec3(specStrength * pow(spec, 16.0)) * atten * light.intensity;
+
+	// added over ambient by blending
+	outFragcolor = vec4(specular + diff, 1.0);
+}
@@ -0,0 +1,61 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// --- structs ---
+struct Light
+{
+	vec3 position;
+	float radius;
+	vec3 intensity;
+	float pad;
+	vec3 direction; // spot axis
+	float cosAngle; // cosine of spot half angle, below -1 for point lights
+};
+
+// --- layouts ---
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+	mat4 view;
+	mat4 proj;
+	mat4 invProj;
+	vec3 position;
+	uvec2 screenSize;
+} camera;
+
+layout(std430, set = 1, binding = 0) buffer readonly PointLights
+{
+	Light lights[];
+} pointLights;
+
+layout(location = 0) flat out uint outLightIndex;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+// Icosahedron, counter clockwise from outside
+#define GOLDEN 1.618034
+#define CIRCUMSCRIBE 1.258409 // ratio of circumradius and inradius, faces stay outside of light sphere
+
+const vec3 vertices[12] = vec3[](
+	vec3(-1.0, GOLDEN, 0.0), vec3(1.0, GOLDEN, 0.0), vec3(-1.0, -GOLDEN, 0.0), vec3(1.0, -GOLDEN, 0.0),
+	vec3(0.0, -1.0, GOLDEN), vec3(0.0, 1.0, GOLDEN), vec3(0.0, -1.0, -GOLDEN), vec3(0.0, 1.0, -GOLDEN),
+	vec3(GOLDEN, 0.0, -1.0), vec3(GOLDEN, 0.0, 1.0), vec3(-GOLDEN, 0.0, -1.0), vec3(-GOLDEN, 0.0, 1.0)
+);
+
+const uint faces[60] = uint[](
+	0u, 11u, 5u,	0u, 5u, 1u,	0u, 1u, 7u,	0u, 7u, 10u,	0u, 10u, 11u,
+	1u, 5u, 9u,	5u, 11u, 4u,	11u, 10u, 2u,	10u, 7u, 6u,	7u, 1u, 8u,
+	3u, 9u, 4u,	3u, 4u, 2u,	3u, 2u, 6u,	3u, 6u, 8u,	3u, 8u, 9u,
+	4u, 9u, 5u,	2u, 4u, 11u,	6u, 2u, 10u,	8u, 6u, 7u,	9u, 8u, 1u
+);
+
+void main()
+{
+	Light light = pointLights.lights[gl_InstanceIndex];
+	vec3 position = light.position + normalize(vertices[faces[gl_VertexIndex]]) * light.radius * CIRCUMSCRIBE;
+
+	outLightIndex = gl_InstanceIndex;
+	gl_Position = camera.proj * camera.view * vec4(position, 1.0);
+}
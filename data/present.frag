@@ -0,0 +1,13 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0, rgba16f) uniform readonly image2D composedImage;
+
+layout(location = 0) in vec2 inUV;
+layout(location = 0) out vec4 outFragcolor;
+
+// Copies output of compute composition to swapchain image
+void main()
+{
+	outFragcolor = imageLoad(composedImage, ivec2(gl_FragCoord.xy));
+}
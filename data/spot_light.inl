@@ -0,0 +1,9 @@
+// Spot cone falloff, smooth over outer fifth of cone angle. One for point lights, whose cosAngle is below -1
+float spotAttenuation(vec3 L, vec3 direction, float cosAngle)
+{
+#ifdef SPOT_LIGHTS
+	return smoothstep(cosAngle, mix(cosAngle, 1.0, 0.2), dot(-L, direction));
+#else
+	return 1.0;
+#endif
+}
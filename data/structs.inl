@@ -4,6 +4,8 @@ struct Light
 	float radius;
 	vec3 intensity;
 	uint mortonCode;
+	vec3 direction; // spot axis
+	float cosAngle; // cosine of spot half angle, below -1 for point lights
 };
 
 struct Key
@@ -18,6 +20,14 @@ struct Node
 	vec3 max;
 };
 
+// lights below BVH node merged to one, shaded instead of them in distant clusters
+struct NodeLight
+{
+	vec4 positionMin; // w max radius
+	vec4 positionMax;
+	vec4 intensity; // sum
+};
+
 struct LevelParam
 {
 	uint count;
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+
+layout(push_constant) uniform pushConstants
+{
+	vec2 renderSize; // pixels of scene color covered by composition
+};
+
+layout(location = 0) in vec2 inUV;
+layout(location = 0) out vec4 outFragcolor;
+
+// Bilinear upscale of dynamic resolution scene color to swapchain image
+void main()
+{
+	// clamped to centers of border texels, so nothing outside render extent is filtered in
+	vec2 texel = clamp(inUV * renderSize, vec2(0.5), renderSize - 0.5);
+	outFragcolor = texture(sceneColor, texel / vec2(textureSize(sceneColor, 0)));
+}
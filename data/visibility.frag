@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 6) flat in uint materialIndex; // part index, first instance of indirect draw
+
+layout(location = 0) out uint outVisibility;
+
+layout(push_constant) uniform PushConstants
+{
+	uint primitiveBits; // triangle of draw in low bits, part in high bits
+};
+
+void main() 
+{
+	outVisibility = materialIndex << primitiveBits | uint(gl_PrimitiveID);
+}
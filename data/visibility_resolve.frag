@@ -0,0 +1,239 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_KHR_shader_subgroup_arithmetic : enable
+
+#ifndef MAX_MATERIAL_TEXTURES // clamped to device limits by renderer
+#define MAX_MATERIAL_TEXTURES 1024
+#endif
+
+// --- structs ---
+struct Material
+{
+	uint albedoMap; // 0 means no map
+	uint normalMap;
+	uint specularMap;
+	uint padding;
+};
+
+struct PartBounds
+{
+	vec4 min;
+	vec4 extent;
+};
+
+struct DrawCommand
+{
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+struct Attributes
+{
+	vec3 position;
+	vec3 color;
+	vec2 texCoord;
+	vec3 normal;
+	vec4 tangent; // w is bitangent sign
+};
+
+// --- layouts ---
+layout(set = 0, binding = 0) uniform CameraUBO
+{
+	mat4 view;
+	mat4 proj;
+	mat4 invProj;
+	vec3 position;
+	uvec2 screenSize;
+} camera;
+
+layout(set = 1, binding = 0) uniform Model
+{
+	mat4 model;
+} transform;
+
+layout(std430, set = 2, binding = 0) buffer readonly Materials
+{
+	Material materials[];
+};
+
+layout(set = 2, binding = 1) uniform sampler2D textures[MAX_MATERIAL_TEXTURES];
+
+layout(std430, set = 2, binding = 2) buffer readonly Bounds
+{
+	PartBounds bounds[];
+};
+
+layout(std430, set = 2, binding = 3) buffer readonly Geometry
+{
+	uint geometry[]; // all vertices followed by all indices
+};
+
+layout(std430, set = 2, binding = 4) buffer readonly DrawCommands
+{
+	DrawCommand drawCommands[]; // one per part, lod selection rewrites index ranges
+};
+
+layout(input_attachment_index = 0, set = 3, binding = 0) uniform usubpassInput inputVisibility;
+
+layout(push_constant) uniform PushConstants
+{
+	uint primitiveBits;
+	uint indexOffset; // index section in words
+};
+
+layout(location = 0) out vec4 outPosition; // unused attachment when position is reconstructed
+layout(location = 1) out vec4 outColor;
+layout(location = 2) out vec2 outNormal;
+
+// Returns ±1
+vec2 signNotZero(vec2 v) 
+{
+	return vec2((v.x >= 0.0) ? 1.0 : -1.0, (v.y >= 0.0) ? 1.0 : -1.0);
+}
+
+vec3 octToFloat32x3(vec2 e) 
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+
+	if (v.z < 0) 
+		v.xy = (1.0 - abs(v.yx)) * signNotZero(v.xy);
+
+	return normalize(v);
+}
+
+// Assume normalized input. Output is on [-1, 1] for each component.
+vec2 float32x3_to_oct(vec3 v) 
+{
+	// Project the sphere onto the octahedron, and then onto the xy plane
+	vec2 p = v.xy * (1.0 / (abs(v.x) + abs(v.y) + abs(v.z)));
+
+	// Reflect the folds of the lower hemisphere over the diagonals
+	return (v.z <= 0.0) ? ((1.0 - abs(p.yx)) * signNotZero(p)) : p;
+}
+
+// Mirrors vertex input of gbuffers.vert and gbuffers_packed.vert
+Attributes fetchVertex(uint vertex, uint part)
+{
+	Attributes attributes;
+
+#ifdef PACKED_VERTICES
+	uint base = vertex * 5;
+	uint signColor = geometry[base + 1] >> 16;
+
+	vec3 quantized = vec3(geometry[base] & 0xFFFFu, geometry[base] >> 16, geometry[base + 1] & 0xFFFFu);
+	attributes.position = bounds[part].min.xyz + quantized * (1.0 / 65535.0) * bounds[part].extent.xyz;
+	attributes.color = vec3((signColor >> 10) & 0x1Fu, (signColor >> 5) & 0x1Fu, signColor & 0x1Fu) * (1.0 / 31.0);
+	attributes.texCoord = unpackHalf2x16(geometry[base + 2]);
+	attributes.normal = octToFloat32x3(unpackSnorm2x16(geometry[base + 3]));
+	attributes.tangent = vec4(octToFloat32x3(unpackSnorm2x16(geometry[base + 4])), (signColor & 0x8000u) != 0 ? -1.0 : 1.0);
+#else
+	uint base = vertex * 14;
+
+	attributes.position = uintBitsToFloat(uvec3(geometry[base], geometry[base + 1], geometry[base + 2]));
+	attributes.color = uintBitsToFloat(uvec3(geometry[base + 3], geometry[base + 4], geometry[base + 5]));
+	attributes.texCoord = uintBitsToFloat(uvec2(geometry[base + 6], geometry[base + 7]));
+	attributes.normal = uintBitsToFloat(uvec3(geometry[base + 8], geometry[base + 9], geometry[base + 10]));
+	attributes.tangent = vec4(uintBitsToFloat(uvec3(geometry[base + 11], geometry[base + 12], geometry[base + 13])), 1.0);
+#endif
+
+	return attributes;
+}
+
+// View space direction through pixel
+vec3 viewRay(vec2 pixel)
+{
+	vec4 direction = camera.invProj * vec4(pixel / vec2(camera.screenSize) * 2.0 - 1.0, 1.0, 1.0);
+	return direction.xyz / direction.w;
+}
+
+// Barycentrics of ray from camera on triangle plane, also outside of triangle for neighbour pixels
+vec3 barycentrics(vec3 direction, vec3 p0, vec3 p1, vec3 p2)
+{
+	vec3 e1 = p1 - p0;
+	vec3 e2 = p2 - p0;
+	vec3 p = cross(direction, e2);
+	vec3 q = cross(-p0, e1);
+	float invDet = 1.0 / dot(e1, p);
+
+	float u = dot(-p0, p) * invDet;
+	float v = dot(direction, q) * invDet;
+
+	return vec3(1.0 - u - v, u, v);
+}
+
+void main() 
+{
+	uint id = subpassLoad(inputVisibility).r;
+	if (id == 0xFFFFFFFF)
+		discard; // background keeps cleared G-buffer
+
+	uint part = id >> primitiveBits;
+	uint primitive = id & ((1u << primitiveBits) - 1u);
+	DrawCommand draw = drawCommands[part];
+	uint first = indexOffset + draw.firstIndex + primitive * 3;
+
+	Attributes v0 = fetchVertex(uint(int(geometry[first]) + draw.vertexOffset), part);
+	Attributes v1 = fetchVertex(uint(int(geometry[first + 1]) + draw.vertexOffset), part);
+	Attributes v2 = fetchVertex(uint(int(geometry[first + 2]) + draw.vertexOffset), part);
+
+	mat4 viewModel = camera.view * transform.model;
+	mat3 invTransModel = transpose(inverse(mat3(viewModel)));
+	mat3 positions = mat3((viewModel * vec4(v0.position, 1.0)).xyz, (viewModel * vec4(v1.position, 1.0)).xyz, (viewModel * vec4(v2.position, 1.0)).xyz);
+
+	// rays of neighbour pixels give screen derivatives of barycentrics for texture lod
+	vec3 b = barycentrics(viewRay(gl_FragCoord.xy), positions[0], positions[1], positions[2]);
+	vec3 bx = barycentrics(viewRay(gl_FragCoord.xy + vec2(1.0, 0.0)), positions[0], positions[1], positions[2]) - b;
+	vec3 by = barycentrics(viewRay(gl_FragCoord.xy + vec2(0.0, 1.0)), positions[0], positions[1], positions[2]) - b;
+
+	mat3x2 texCoords = mat3x2(v0.texCoord, v1.texCoord, v2.texCoord);
+	vec2 texCoord = texCoords * b;
+	vec2 texCoordDx = texCoords * bx;
+	vec2 texCoordDy = texCoords * by;
+
+	vec3 N = invTransModel * (mat3(v0.normal, v1.normal, v2.normal) * b);
+	vec3 T = invTransModel * (mat3(v0.tangent.xyz, v1.tangent.xyz, v2.tangent.xyz) * b);
+	T -= dot(T, N) * N;
+
+	float specular = 0.0;
+	vec3 normalTex = vec3(0.5, 0.5, 1.0);
+
+	outColor = vec4(mat3(v0.color, v1.color, v2.color) * b, 1.0);
+
+	// texture index has to be uniform, subgroup visits its unique parts one by one
+	bool pending = true;
+	while (true)
+	{
+		uint current = subgroupMin(pending ? part : 0xFFFFFFFF);
+		if (current == 0xFFFFFFFF)
+			break;
+
+		Material material = materials[current];
+
+		if (current == part)
+		{
+			if (material.albedoMap > 0)
+				outColor.rgb = textureGrad(textures[material.albedoMap], texCoord, texCoordDx, texCoordDy).rgb;
+
+			if (material.specularMap > 0)
+				specular = textureGrad(textures[material.specularMap], texCoord, texCoordDx, texCoordDy).r;
+
+			if (material.normalMap > 0) 
+				normalTex = textureGrad(textures[material.normalMap], texCoord, texCoordDx, texCoordDy).xyz;
+
+			pending = false;
+		}
+	}
+
+	N = normalize(N);
+	T = normalize(T);
+	vec3 B = cross(N, T) * v0.tangent.w; // sign is shared by triangle
+
+	mat3 TBN = mat3(T, B, N);
+
+	outNormal = float32x3_to_oct(TBN * normalize(normalTex * 2.0 - 1.0));
+	outColor.a = specular;
+	outPosition = vec4(positions * b, 1.0);
+}
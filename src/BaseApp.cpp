@@ -103,6 +103,8 @@ BaseApp::BaseApp()
 			2.0f,
 			{ 1.0f, 1.0f, 1.0f/* - i * 0.2f*/ },
 			0.0f,
+			{ 0.0f, -1.0f, 0.0f },
+			-2.0f,
 		});
 
 		mLightsDirections.emplace_back(glm::normalize(glm::vec3(rand(), rand(), rand())));
@@ -122,7 +124,7 @@ GLFWwindow* BaseApp::createWindow()
 
 void BaseApp::createScene()
 {
-	mScene = Scene(SceneConfigurations::data[mUI.mContext.currentScene], mRenderer, *mThreadPool, mWindow);
+	mScene = Scene(SceneConfigurations::data[mUI.mContext.currentScene], mRenderer, *mThreadPool, mWindow, mUI.mContext.packedVertices);
 	mUI.mContext.lightBoundMin = SceneConfigurations::data[mUI.mContext.currentScene].lightExtentMin;
 	mUI.mContext.lightBoundMax = SceneConfigurations::data[mUI.mContext.currentScene].lightExtentMax;
 	mRenderer.onSceneChange();
@@ -163,6 +165,22 @@ void BaseApp::updateLights(float dt)
 		}
 	};
 
+	// every n-th light of hundred becomes spot light pointing roughly down
+	if (mUI.mContext.spotLightsDirtyBit)
+	{
+		const auto spotsPerHundred = static_cast<size_t>(mUI.mContext.spotLightFraction * 100.0f + 0.5f);
+		const float cosAngle = std::cos(glm::radians(mUI.mContext.spotAngle));
+
+		for (size_t i = 0; i < mLights.size(); i++)
+		{
+			bool spot = i % 100 < spotsPerHundred;
+			mLights[i].direction = glm::normalize(randVec3() * glm::vec3(0.5f, 0.0f, 0.5f) + glm::vec3(0.0f, -1.0f, 0.0f));
+			mLights[i].cosAngle = spot ? cosAngle : -2.0f;
+		}
+
+		mUI.mContext.spotLightsDirtyBit = false;
+	}
+
 	if (mUI.mContext.lightSpeed > 0.f)
 	{
 		if (mUI.mContext.lightsCount > (1 << 8))
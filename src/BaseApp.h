@@ -14,12 +14,15 @@
 
 #define MAX_LIGHTS 500'000
 
+// spot light when cone angle is set, point lights keep cosine below -1
 struct PointLight
 {
 	glm::vec3 position;
 	float radius;
 	glm::vec3 intensity;
 	float padding;
+	glm::vec3 direction;
+	float cosAngle;
 };
 
 class BaseApp
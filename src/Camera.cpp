@@ -84,11 +84,49 @@ glm::mat4 Camera::getViewMatrix() const
 	return glm::transpose(glm::toMat4(mRotation)) * glm::translate(glm::mat4(1.0f), -mPosition);
 }
 
+glm::mat4 Camera::getProjectionMatrix(float aspect, bool reversedDepth) const
+{
+	auto projection = glm::perspective(mFov, aspect, mNear, mFar);
+
+	// near plane maps to one and infinity to zero, float depth keeps relative precision over whole range
+	if (reversedDepth)
+	{
+		projection[2][2] = 0.0f;
+		projection[3][2] = mNear;
+	}
+
+	projection[1][1] *= -1; //since the Y axis of Vulkan NDC points down
+
+	return projection;
+}
+
 glm::vec3 Camera::getPosition() const
 {
 	return mPosition;
 }
 
+void Camera::setPerspective(float fov, float zNear, float zFar)
+{
+	mFov = fov;
+	mNear = zNear;
+	mFar = glm::max(zFar, zNear * 2.0f);
+}
+
+float Camera::getFov() const
+{
+	return mFov;
+}
+
+float Camera::getNear() const
+{
+	return mNear;
+}
+
+float Camera::getFar() const
+{
+	return mFar;
+}
+
 void Camera::onMouseButton(GLFWwindow* window, int button, int action, int mods)
 {
 	if (action == GLFW_PRESS) 
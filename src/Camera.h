@@ -22,8 +22,14 @@ public:
 
 	void setWindowExtent(glm::uvec2 extent); // todo update on resize
 	glm::mat4 getViewMatrix() const;
+	glm::mat4 getProjectionMatrix(float aspect, bool reversedDepth = false) const; // Vulkan NDC, Y points down
 	glm::vec3 getPosition() const;
 
+	void setPerspective(float fov, float zNear, float zFar);
+	float getFov() const; // vertical, in radians
+	float getNear() const;
+	float getFar() const;
+
 private:
 	void onMouseButton(GLFWwindow* window, int button, int action, int mods);
 	void onKeyPress(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -41,4 +47,8 @@ private:
 	glm::quat mRotation; 
 	float mRotationSpeed = glm::pi<float>();
 	float mMoveSpeed = 7.f;
+
+	float mFov = glm::radians(45.0f);
+	float mNear = 0.05f;
+	float mFar = 100.0f;
 };
@@ -48,7 +48,11 @@ namespace
 		auto formats = device.getSurfaceFormatsKHR(windowSurface);
 		auto presentModes = device.getSurfacePresentModesKHR(windowSurface);
 
-		return indices.isComplete() && extensionsSupported && (!formats.empty() && !presentModes.empty());
+		// material index is passed through first instance of indirect draws
+		auto features = device.getFeatures();
+		bool featuresSupported = features.drawIndirectFirstInstance && features.shaderSampledImageArrayDynamicIndexing;
+
+		return indices.isComplete() && extensionsSupported && featuresSupported && (!formats.empty() && !presentModes.empty());
 	}
 
 	VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
@@ -356,9 +360,19 @@ void Context::createLogicalDevice()
 		queueInfo.emplace_back(info);
 	}
 
+	auto supportedFeatures = mPhysicalDevice.getFeatures();
+
 	vk::PhysicalDeviceFeatures deviceFeatures;
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 	deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+	deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect; // optional, falls back to single draw indirect calls
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery; // optional, G-buffer statistics in UI
+	deviceFeatures.depthClamp = supportedFeatures.depthClamp; // optional, keeps light volumes crossing far plane
+	deviceFeatures.geometryShader = supportedFeatures.geometryShader; // optional, primitive ID of visibility buffer
+
+	mEnabledFeatures = deviceFeatures;
 
 	// Create the logical device
 	vk::DeviceCreateInfo deviceInfo;
@@ -89,6 +89,11 @@ public:
 		return *mComputeCommandPool;
 	}
 
+	const vk::PhysicalDeviceFeatures& getEnabledFeatures() const
+	{
+		return mEnabledFeatures;
+	}
+
 private:
 	void createInstance();
 	void setupDebugCallback();
@@ -118,5 +123,7 @@ private:
 	vk::UniqueCommandPool	mDynamicCommandPool;
 	vk::UniqueCommandPool	mComputeCommandPool;
 
+	vk::PhysicalDeviceFeatures	mEnabledFeatures;
+
 	//vk::PhysicalDeviceProperties	mPhyisicalDeviceProperties;
 };
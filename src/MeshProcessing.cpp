@@ -0,0 +1,692 @@
+/**
+ * @file 'MeshProcessing.cpp'
+ * @brief Mesh processing done at cache bake time
+ * @copyright The MIT license
+ * @author Matej Karas
+ */
+
+#include "MeshProcessing.h"
+#include <glm/gtc/packing.hpp>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+	constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+	glm::vec2 signNotZero(glm::vec2 v)
+	{
+		return { v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f };
+	}
+
+	// Same mapping as float32x3_to_oct in gbuffers.frag
+	uint32_t packOctahedral(glm::vec3 v, glm::vec3 fallback)
+	{
+		auto length = glm::length(v);
+		if (!(length > 0.0f) || !std::isfinite(length))
+			v = fallback;
+
+		glm::vec2 p = glm::vec2(v) * (1.0f / (std::abs(v.x) + std::abs(v.y) + std::abs(v.z)));
+
+		if (v.z <= 0.0f)
+			p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * signNotZero(p);
+
+		return glm::packSnorm2x16(p);
+	}
+
+	uint16_t quantizeUnorm16(float value)
+	{
+		return static_cast<uint16_t>(glm::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+	}
+
+	uint16_t quantizeUnorm5(float value)
+	{
+		return static_cast<uint16_t>(glm::clamp(value, 0.0f, 1.0f) * 31.0f + 0.5f);
+	}
+}
+
+float mesh::CacheStatistics::acmr() const
+{
+	return triangles > 0 ? static_cast<float>(transformedVertices) / triangles : 0.0f;
+}
+
+float mesh::CacheStatistics::atvr() const
+{
+	return uniqueVertices > 0 ? static_cast<float>(transformedVertices) / uniqueVertices : 0.0f;
+}
+
+mesh::CacheStatistics& mesh::CacheStatistics::operator+=(const CacheStatistics& other)
+{
+	transformedVertices += other.transformedVertices;
+	uniqueVertices += other.uniqueVertices;
+	triangles += other.triangles;
+	return *this;
+}
+
+mesh::Bounds mesh::computeBounds(const std::vector<util::Vertex>& vertices)
+{
+	Bounds bounds;
+
+	if (vertices.empty())
+		return bounds;
+
+	bounds.min = bounds.max = vertices[0].pos;
+	for (const auto& vertex : vertices)
+	{
+		bounds.min = glm::min(bounds.min, vertex.pos);
+		bounds.max = glm::max(bounds.max, vertex.pos);
+	}
+
+	return bounds;
+}
+
+std::vector<util::PackedVertex> mesh::packVertices(const std::vector<util::Vertex>& vertices, const std::vector<uint32_t>& indices, const Bounds& bounds)
+{
+	// accumulate bitangents from triangles to get handedness of tangent frame
+	std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const auto& v0 = vertices[indices[i]];
+		const auto& v1 = vertices[indices[i + 1]];
+		const auto& v2 = vertices[indices[i + 2]];
+
+		auto edge1 = v1.pos - v0.pos;
+		auto edge2 = v2.pos - v0.pos;
+		auto dtUV1 = v1.texCoord - v0.texCoord;
+		auto dtUV2 = v2.texCoord - v0.texCoord;
+
+		float determinant = dtUV1.x * dtUV2.y - dtUV2.x * dtUV1.y;
+		if (determinant == 0.0f)
+			continue;
+
+		auto bitangent = (dtUV1.x * edge2 - dtUV2.x * edge1) / determinant;
+
+		for (size_t j = 0; j < 3; j++)
+			bitangents[indices[i + j]] += bitangent;
+	}
+
+	auto extent = bounds.max - bounds.min;
+	extent = glm::vec3(extent.x > 0.0f ? extent.x : 1.0f, extent.y > 0.0f ? extent.y : 1.0f, extent.z > 0.0f ? extent.z : 1.0f);
+
+	std::vector<util::PackedVertex> packed(vertices.size());
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const auto& vertex = vertices[i];
+		auto& out = packed[i];
+
+		auto position = (vertex.pos - bounds.min) / extent;
+		out.pos[0] = quantizeUnorm16(position.x);
+		out.pos[1] = quantizeUnorm16(position.y);
+		out.pos[2] = quantizeUnorm16(position.z);
+
+		bool negativeSign = glm::dot(glm::cross(vertex.normal, vertex.tangent), bitangents[i]) < 0.0f;
+		out.signColor = static_cast<uint16_t>((negativeSign ? 0x8000 : 0)
+			| quantizeUnorm5(vertex.color.r) << 10
+			| quantizeUnorm5(vertex.color.g) << 5
+			| quantizeUnorm5(vertex.color.b));
+
+		out.texCoord = glm::packHalf2x16(vertex.texCoord);
+		out.normal = packOctahedral(vertex.normal, glm::vec3(0.0f, 0.0f, 1.0f));
+		out.tangent = packOctahedral(vertex.tangent, glm::vec3(1.0f, 0.0f, 0.0f));
+	}
+
+	return packed;
+}
+
+mesh::CacheStatistics mesh::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	CacheStatistics statistics;
+	statistics.triangles = indices.size() / 3;
+
+	// vertex is in cache when it was inserted less than cache size insertions ago
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+
+	for (auto index : indices)
+	{
+		if (time - timestamps[index] > VERTEX_CACHE_SIZE)
+		{
+			timestamps[index] = time++;
+			statistics.transformedVertices++;
+		}
+
+		if (!used[index])
+		{
+			used[index] = true;
+			statistics.uniqueVertices++;
+		}
+	}
+
+	return statistics;
+}
+
+std::vector<size_t> mesh::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	std::vector<size_t> clusters;
+	const size_t triangleCount = indices.size() / 3;
+
+	if (triangleCount == 0)
+		return clusters;
+
+	// vertex to triangle adjacency
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+
+	std::vector<uint32_t> adjacency(adjacencyOffsets.back());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+	size_t cursor = 0;
+
+	auto skipDeadEnd = [&]() -> int64_t
+	{
+		while (!deadEnd.empty())
+		{
+			auto vertex = deadEnd.back();
+			deadEnd.pop_back();
+
+			if (liveTriangles[vertex] > 0)
+				return vertex;
+		}
+
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (liveTriangles[cursor] > 0)
+				return static_cast<int64_t>(cursor);
+		}
+
+		return -1;
+	};
+
+	int64_t fanning = skipDeadEnd();
+	clusters.emplace_back(0);
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		// emit all remaining triangles around fanning vertex
+		for (auto i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; i++)
+		{
+			auto triangle = adjacency[i];
+			if (emitted[triangle])
+				continue;
+
+			for (size_t j = 0; j < 3; j++)
+			{
+				auto vertex = indices[triangle * 3 + j];
+
+				output.emplace_back(vertex);
+				deadEnd.emplace_back(vertex);
+				candidates.emplace_back(vertex);
+				liveTriangles[vertex]--;
+
+				if (time - timestamps[vertex] > VERTEX_CACHE_SIZE)
+					timestamps[vertex] = time++;
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// pick candidate which stays longest in cache after its fan is emitted
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+
+		for (auto vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (time - timestamps[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+				priority = time - timestamps[vertex];
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		// dead end starts new cluster
+		if (next < 0)
+		{
+			next = skipDeadEnd();
+
+			if (next >= 0 && output.size() > clusters.back())
+				clusters.emplace_back(output.size());
+		}
+
+		fanning = next;
+	}
+
+	indices = std::move(output);
+	return clusters;
+}
+
+void mesh::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<size_t>& clusters, const std::vector<util::Vertex>& vertices)
+{
+	if (clusters.size() <= 1)
+		return;
+
+	auto triangleCentroid = [&](size_t i)
+	{
+		return (vertices[indices[i]].pos + vertices[indices[i + 1]].pos + vertices[indices[i + 2]].pos) / 3.0f;
+	};
+
+	auto triangleNormal = [&](size_t i) // area weighted
+	{
+		const auto& p0 = vertices[indices[i]].pos;
+		return glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+	};
+
+	glm::vec3 meshCentroid(0.0f);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		meshCentroid += triangleCentroid(i);
+	meshCentroid /= static_cast<float>(indices.size() / 3);
+
+	// clusters facing away from mesh center are likely occluders, draw them first
+	std::vector<std::pair<float, size_t>> sortKeys;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		auto begin = clusters[c];
+		auto end = c + 1 < clusters.size() ? clusters[c + 1] : indices.size();
+
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+
+		for (auto i = begin; i < end; i += 3)
+		{
+			centroid += triangleCentroid(i);
+			normal += triangleNormal(i);
+		}
+
+		centroid /= static_cast<float>((end - begin) / 3);
+		sortKeys.emplace_back(glm::dot(centroid - meshCentroid, normal), c);
+	}
+
+	std::stable_sort(sortKeys.begin(), sortKeys.end(), [](const auto& l, const auto& r) { return l.first > r.first; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	for (const auto& key : sortKeys)
+	{
+		auto begin = clusters[key.second];
+		auto end = key.second + 1 < clusters.size() ? clusters[key.second + 1] : indices.size();
+		output.insert(output.end(), indices.begin() + begin, indices.begin() + end);
+	}
+
+	indices = std::move(output);
+}
+
+std::vector<uint32_t> mesh::optimizeVertexFetch(std::vector<util::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), ~0u);
+	std::vector<util::Vertex> output;
+	output.reserve(vertices.size());
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == ~0u)
+		{
+			remap[index] = static_cast<uint32_t>(output.size());
+			output.emplace_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices = std::move(output);
+	return remap;
+}
+
+namespace
+{
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+
+		Quadric() = default;
+		Quadric(const glm::dvec3& n, double d)
+			: a2(n.x * n.x), ab(n.x * n.y), ac(n.x * n.z), ad(n.x * d)
+			, b2(n.y * n.y), bc(n.y * n.z), bd(n.y * d)
+			, c2(n.z * n.z), cd(n.z * d)
+			, d2(d * d)
+		{}
+
+		Quadric& operator+=(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+			return *this;
+		}
+
+		double evaluate(const glm::dvec3& p) const // sum of squared distances to planes
+		{
+			double result = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+				+ b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+				+ c2 * p.z * p.z + 2 * cd * p.z
+				+ d2;
+
+			return std::max(result, 0.0);
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+}
+
+std::vector<uint32_t> mesh::simplify(const std::vector<util::Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error)
+{
+	error = 0.0f;
+	std::vector<uint32_t> result(indices);
+
+	// vertices with same position but different attributes lie on seam
+	std::unordered_map<glm::vec3, uint32_t> positionIds;
+	std::vector<uint32_t> positionId(vertices.size());
+	std::vector<uint32_t> positionUses;
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		auto it = positionIds.try_emplace(vertices[i].pos, static_cast<uint32_t>(positionUses.size())).first;
+		if (it->second == positionUses.size())
+			positionUses.emplace_back(0);
+
+		positionId[i] = it->second;
+		positionUses[it->second]++;
+	}
+
+	std::vector<bool> locked(vertices.size(), false);
+	for (size_t i = 0; i < vertices.size(); i++)
+		locked[i] = positionUses[positionId[i]] > 1;
+
+	// edges used by single triangle are on border
+	auto edgeKey = [&](uint32_t a, uint32_t b)
+	{
+		auto pa = positionId[a], pb = positionId[b];
+		return pa < pb ? (uint64_t(pa) << 32 | pb) : (uint64_t(pb) << 32 | pa);
+	};
+
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	for (size_t i = 0; i + 2 < result.size(); i += 3)
+	{
+		for (size_t j = 0; j < 3; j++)
+			edgeUses[edgeKey(result[i + j], result[i + (j + 1) % 3])]++;
+	}
+
+	for (size_t i = 0; i + 2 < result.size(); i += 3)
+	{
+		for (size_t j = 0; j < 3; j++)
+		{
+			auto a = result[i + j], b = result[i + (j + 1) % 3];
+			if (edgeUses[edgeKey(a, b)] == 1)
+				locked[a] = locked[b] = true;
+		}
+	}
+
+	// plane quadrics of adjacent triangles
+	std::vector<Quadric> quadrics(vertices.size());
+	for (size_t i = 0; i + 2 < result.size(); i += 3)
+	{
+		glm::dvec3 p0 = vertices[result[i]].pos, p1 = vertices[result[i + 1]].pos, p2 = vertices[result[i + 2]].pos;
+		auto normal = glm::cross(p1 - p0, p2 - p0);
+		auto length = glm::length(normal);
+
+		if (length == 0.0)
+			continue;
+
+		normal /= length;
+		Quadric quadric(normal, -glm::dot(normal, p0));
+
+		for (size_t j = 0; j < 3; j++)
+			quadrics[result[i + j]] += quadric;
+	}
+
+	auto position = [&](uint32_t v) { return glm::dvec3(vertices[v].pos); };
+
+	std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertices.size());
+	std::vector<bool> touched(vertices.size());
+	double maxCost = 0.0;
+
+	while (result.size() > targetIndexCount)
+	{
+		// vertex to triangle adjacency of current mesh
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (auto index : result)
+			adjacencyOffsets[index + 1]++;
+		std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+			adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+
+		// cost of collapsing every edge onto its endpoint
+		collapses.clear();
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			for (size_t j = 0; j < 3; j++)
+			{
+				uint32_t a = result[i + j], b = result[i + (j + 1) % 3];
+
+				for (auto [from, to] : { std::make_pair(a, b), std::make_pair(b, a) })
+				{
+					if (locked[from])
+						continue;
+
+					Quadric quadric = quadrics[from];
+					quadric += quadrics[to];
+					collapses.push_back({ from, to, quadric.evaluate(position(to)) });
+				}
+			}
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const auto& l, const auto& r) { return l.cost < r.cost; });
+
+		for (size_t i = 0; i < remap.size(); i++)
+			remap[i] = static_cast<uint32_t>(i);
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t removedTriangles = 0;
+		size_t neededTriangles = (result.size() - targetIndexCount) / 3;
+
+		for (const auto& collapse : collapses)
+		{
+			if (removedTriangles >= neededTriangles)
+				break;
+
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// reject collapse flipping any remaining triangle
+			bool flipped = false;
+			size_t collapsedTriangles = 0;
+
+			for (auto t = adjacencyOffsets[collapse.from]; t < adjacencyOffsets[collapse.from + 1] && !flipped; t++)
+			{
+				const uint32_t* triangle = &result[adjacency[t] * 3];
+
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					collapsedTriangles++;
+					continue;
+				}
+
+				glm::dvec3 before[3], after[3];
+				for (size_t k = 0; k < 3; k++)
+				{
+					before[k] = position(triangle[k]);
+					after[k] = triangle[k] == collapse.from ? position(collapse.to) : before[k];
+				}
+
+				auto normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				auto normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				flipped = glm::dot(normalBefore, normalAfter) <= 0.0;
+			}
+
+			if (flipped)
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			maxCost = std::max(maxCost, collapse.cost);
+			removedTriangles += collapsedTriangles;
+
+			touched[collapse.from] = touched[collapse.to] = true;
+			for (auto t = adjacencyOffsets[collapse.from]; t < adjacencyOffsets[collapse.from + 1]; t++)
+			{
+				for (size_t k = 0; k < 3; k++)
+					touched[result[adjacency[t] * 3 + k]] = true;
+			}
+		}
+
+		if (removedTriangles == 0)
+			break;
+
+		// apply collapses and drop degenerate triangles
+		size_t writeOffset = 0;
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+
+			if (a == b || b == c || c == a)
+				continue;
+
+			result[writeOffset++] = a;
+			result[writeOffset++] = b;
+			result[writeOffset++] = c;
+		}
+
+		result.resize(writeOffset);
+	}
+
+	error = static_cast<float>(std::sqrt(maxCost));
+	return result;
+}
+
+std::vector<mesh::Meshlet> mesh::buildMeshlets(const std::vector<util::Vertex>& vertices, const std::vector<uint32_t>& indices,
+	uint32_t firstIndex, uint32_t indexCount, size_t maxVertices, size_t maxTriangles)
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint32_t> vertexMarks(vertices.size(), ~0u); // index of meshlet which already contains vertex
+
+	auto finishMeshlet = [&](uint32_t begin, uint32_t end)
+	{
+		Meshlet meshlet;
+		meshlet.firstIndex = begin;
+		meshlet.indexCount = end - begin;
+
+		// bounding sphere around center of bounding box
+		glm::vec3 min = vertices[meshletVertices[0]].pos, max = min;
+		for (auto v : meshletVertices)
+		{
+			min = glm::min(min, vertices[v].pos);
+			max = glm::max(max, vertices[v].pos);
+		}
+
+		glm::vec3 center = (min + max) * 0.5f;
+		float radius = 0.0f;
+		for (auto v : meshletVertices)
+			radius = std::max(radius, glm::length(vertices[v].pos - center));
+
+		meshlet.boundingSphere = glm::vec4(center, radius);
+
+		// normal cone of triangles
+		std::vector<glm::vec3> normals;
+		glm::vec3 axis(0.0f);
+
+		for (auto i = begin; i < end; i += 3)
+		{
+			const auto& p0 = vertices[indices[i]].pos;
+			auto normal = glm::cross(vertices[indices[i + 1]].pos - p0, vertices[indices[i + 2]].pos - p0);
+			auto length = glm::length(normal);
+
+			if (length > 0.0f)
+			{
+				normals.emplace_back(normal / length);
+				axis += normals.back();
+			}
+		}
+
+		float minDot = -1.0f;
+		if (glm::length(axis) > 0.0f)
+		{
+			axis = glm::normalize(axis);
+			minDot = 1.0f;
+
+			for (const auto& normal : normals)
+				minDot = std::min(minDot, glm::dot(axis, normal));
+		}
+
+		meshlet.cone = glm::vec4(axis, minDot > 0.0f ? std::sqrt(1.0f - minDot * minDot) : 2.0f);
+		meshlets.emplace_back(meshlet);
+		meshletVertices.clear();
+	};
+
+	uint32_t begin = firstIndex;
+	for (auto i = firstIndex; i + 2 < firstIndex + indexCount; i += 3)
+	{
+		auto meshletId = static_cast<uint32_t>(meshlets.size());
+
+		size_t newVertices = 0;
+		for (size_t j = 0; j < 3; j++)
+			newVertices += vertexMarks[indices[i + j]] != meshletId;
+
+		if (meshletVertices.size() + newVertices > maxVertices || (i - begin) / 3 + 1 > maxTriangles)
+		{
+			finishMeshlet(begin, i);
+			begin = i;
+			meshletId++;
+		}
+
+		for (size_t j = 0; j < 3; j++)
+		{
+			auto v = indices[i + j];
+			if (vertexMarks[v] != meshletId)
+			{
+				vertexMarks[v] = meshletId;
+				meshletVertices.emplace_back(v);
+			}
+		}
+	}
+
+	if (!meshletVertices.empty())
+		finishMeshlet(begin, firstIndex + indexCount - (indexCount % 3));
+
+	return meshlets;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file 'MeshProcessing.h'
+ * @brief Mesh processing done at cache bake time
+ * @copyright The MIT license
+ * @author Matej Karas
+ */
+
+#pragma once
+#include <vector>
+#include "Util.h"
+
+namespace mesh
+{
+	struct Bounds
+	{
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+	};
+
+	struct Lod
+	{
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		float error = 0.0f; // object space distance to full resolution mesh
+		uint32_t firstMeshlet = 0;
+		uint32_t meshletCount = 0;
+	};
+
+	struct Meshlet // contiguous chunk of index buffer
+	{
+		glm::vec4 boundingSphere = glm::vec4(0.0f); // object space
+		glm::vec4 cone = glm::vec4(0.0f); // normal cone axis and sine of its half angle, greater than 1 disables backface test
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+	};
+
+	struct CacheStatistics
+	{
+		size_t transformedVertices = 0; // post transform cache misses
+		size_t uniqueVertices = 0;
+		size_t triangles = 0;
+
+		float acmr() const; // average cache miss ratio, transformed vertices per triangle
+		float atvr() const; // average transform to vertex ratio, 1.0 is optimal
+		CacheStatistics& operator+=(const CacheStatistics& other);
+	};
+
+	Bounds computeBounds(const std::vector<util::Vertex>& vertices);
+
+	// Simulates FIFO post transform cache
+	CacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Tipsify reordering of triangles, returns offsets of clusters (in indices) usable for overdraw sorting
+	std::vector<size_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Sorts clusters so outward facing ones are drawn first, keeps triangle order inside clusters
+	void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<size_t>& clusters, const std::vector<util::Vertex>& vertices);
+
+	// Orders vertices by first use and drops unreferenced ones, returns remap table (old to new index, ~0u if dropped)
+	std::vector<uint32_t> optimizeVertexFetch(std::vector<util::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Splits index range to meshlets in existing triangle order
+	std::vector<Meshlet> buildMeshlets(const std::vector<util::Vertex>& vertices, const std::vector<uint32_t>& indices,
+		uint32_t firstIndex, uint32_t indexCount, size_t maxVertices = 64, size_t maxTriangles = 124);
+
+	// Quadric error edge collapse onto existing vertices, border and attribute seam vertices stay locked
+	std::vector<uint32_t> simplify(const std::vector<util::Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error);
+
+	// Quantizes positions to bounds, encodes normal and tangent octahedrally, bitangent sign is computed from triangles
+	std::vector<util::PackedVertex> packVertices(const std::vector<util::Vertex>& vertices, const std::vector<uint32_t>& indices, const Bounds& bounds);
+}
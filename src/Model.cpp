@@ -12,6 +12,7 @@
 #include "tiny_obj_loader.h"
 
 #include <fstream>
+#include <algorithm>
 #include <experimental/filesystem>
 #include <thread>
 #include "lodepng.h"
@@ -35,12 +36,7 @@ namespace
 {
 	namespace fs = std::experimental::filesystem;
 
-	struct MaterialUBO
-	{
-		uint32_t hasAlbedoMap = 0;
-		uint32_t hasNormalMap = 0;
-		uint32_t hasSpecularMap = 0;
-	};
+	constexpr uint32_t CACHE_VERSION = 4; // increment when baked data changes, older cache is rebaked
 
 	template<typename... T>
 	void write4B(std::ofstream& file, const size_t head, const T&... tail)
@@ -72,29 +68,35 @@ namespace
 			file.write(reinterpret_cast<const char*>(ptr), size);
 		};
 
-		write4B(file, 0, group.size());
+		write4B(file, CACHE_VERSION, group.size());
 		for (const auto& m : group)
 		{
-			write4B(file, m.indices.size(), m.vertices.size(), m.albedoMapPath.size(), m.normalMapPath.size(), m.specularMapPath.size());
+			write4B(file, m.indices.size(), m.vertices.size(), m.lods.size(), m.meshlets.size(), m.albedoMapPath.size(), m.normalMapPath.size(), m.specularMapPath.size());
 			write(m.albedoMapPath.data(), m.albedoMapPath.size());
 			write(m.normalMapPath.data(), m.normalMapPath.size());
 			write(m.specularMapPath.data(), m.specularMapPath.size());
+			write(&m.bounds, sizeof(mesh::Bounds));
+			write(m.lods.data(), m.lods.size() * sizeof(mesh::Lod));
+			write(m.meshlets.data(), m.meshlets.size() * sizeof(mesh::Meshlet));
 			write(m.indices.data(), m.indices.size() * sizeof(uint32_t));
 			write(m.vertices.data(), m.vertices.size() * sizeof(util::Vertex));
+			write(m.packedVertices.data(), m.packedVertices.size() * sizeof(util::PackedVertex));
 		}
 	}
 
 	std::vector<MeshMaterialGroup> readCacheModelData(std::ifstream& file)
 	{
-
 		uint32_t header, groupSize;
 		read4B(file, header, groupSize);
 
+		if (header != CACHE_VERSION)
+			return {};
+
 		std::vector<MeshMaterialGroup> materialGroups(groupSize);
 		for (auto& m : materialGroups)
 		{
-			uint32_t indexCount, vertexCount, albedoPathSize, normalPathSize, specularPathSize;
-			read4B(file, indexCount, vertexCount, albedoPathSize, normalPathSize, specularPathSize);
+			uint32_t indexCount, vertexCount, lodCount, meshletCount, albedoPathSize, normalPathSize, specularPathSize;
+			read4B(file, indexCount, vertexCount, lodCount, meshletCount, albedoPathSize, normalPathSize, specularPathSize);
 
 			m.albedoMapPath.resize(albedoPathSize);
 			file.read(reinterpret_cast<char*>(m.albedoMapPath.data()), albedoPathSize);
@@ -105,11 +107,22 @@ namespace
 			m.specularMapPath.resize(specularPathSize);
 			file.read(reinterpret_cast<char*>(m.specularMapPath.data()), specularPathSize);
 
+			file.read(reinterpret_cast<char*>(&m.bounds), sizeof(mesh::Bounds));
+
+			m.lods.resize(lodCount);
+			file.read(reinterpret_cast<char*>(m.lods.data()), lodCount * sizeof(mesh::Lod));
+
+			m.meshlets.resize(meshletCount);
+			file.read(reinterpret_cast<char*>(m.meshlets.data()), meshletCount * sizeof(mesh::Meshlet));
+
 			m.indices.resize(indexCount);
 			file.read(reinterpret_cast<char*>(m.indices.data()), indexCount * sizeof(uint32_t));
 
 			m.vertices.resize(vertexCount);
 			file.read(reinterpret_cast<char*>(m.vertices.data()), vertexCount * sizeof(util::Vertex));
+
+			m.packedVertices.resize(vertexCount);
+			file.read(reinterpret_cast<char*>(m.packedVertices.data()), vertexCount * sizeof(util::PackedVertex));
 		}
 
 		return materialGroups;
@@ -120,9 +133,12 @@ namespace
 		auto folder = fs::path(path).parent_path();
 		
 		if (std::ifstream cacheFile((folder / fs::path(path).stem()).concat(".asd"), std::ios::binary); cacheFile.is_open())
-			return readCacheModelData(cacheFile);
+		{
+			if (auto materialGroups = readCacheModelData(cacheFile); !materialGroups.empty())
+				return materialGroups;
+		}
 
-		// Cache file not found
+		// Cache file not found or outdated
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
@@ -238,45 +254,153 @@ namespace
 			}
 		}
 
+		// optimize for post transform cache, overdraw and vertex fetch, then bake packed vertex stream
+		mesh::CacheStatistics statisticsBefore, statisticsAfter;
+
+		for (auto& group : materialGroups)
+		{
+			statisticsBefore += mesh::analyzeVertexCache(group.indices, group.vertices.size());
+
+			auto clusters = mesh::optimizeVertexCache(group.indices, group.vertices.size());
+			mesh::optimizeOverdraw(group.indices, clusters, group.vertices);
+			mesh::optimizeVertexFetch(group.vertices, group.indices);
+
+			statisticsAfter += mesh::analyzeVertexCache(group.indices, group.vertices.size());
+
+			group.bounds = mesh::computeBounds(group.vertices);
+			group.packedVertices = mesh::packVertices(group.vertices, group.indices, group.bounds);
+
+			// simplified lods reuse vertices of full resolution mesh, their indices are appended
+			group.lods.push_back({ 0, static_cast<uint32_t>(group.indices.size()), 0.0f });
+			auto lodIndices = group.indices;
+
+			while (group.lods.size() < MAX_MESH_LODS && !lodIndices.empty())
+			{
+				float error;
+				auto simplified = mesh::simplify(group.vertices, lodIndices, lodIndices.size() / 6 * 3, error);
+
+				if (simplified.empty() || simplified.size() > lodIndices.size() * 9 / 10) // not worth another lod
+					break;
+
+				mesh::optimizeVertexCache(simplified, group.vertices.size());
+
+				group.lods.push_back({ static_cast<uint32_t>(group.indices.size()), static_cast<uint32_t>(simplified.size()), group.lods.back().error + error });
+				group.indices.insert(group.indices.end(), simplified.begin(), simplified.end());
+				lodIndices = std::move(simplified);
+			}
+
+			for (auto& lod : group.lods)
+			{
+				auto meshlets = mesh::buildMeshlets(group.vertices, group.indices, lod.firstIndex, lod.indexCount);
+
+				lod.firstMeshlet = static_cast<uint32_t>(group.meshlets.size());
+				lod.meshletCount = static_cast<uint32_t>(meshlets.size());
+				group.meshlets.insert(group.meshlets.end(), meshlets.begin(), meshlets.end());
+			}
+		}
+
+		std::cout << "Mesh optimization of " << path << ": ACMR " << statisticsBefore.acmr() << " -> " << statisticsAfter.acmr()
+			<< ", ATVR " << statisticsBefore.atvr() << " -> " << statisticsAfter.atvr() << std::endl;
+
 		writeCacheModelData(materialGroups, path);
 		
 		return materialGroups;
 	}
 }
 
+uint32_t getMaterialTextureCount(vk::PhysicalDevice physicalDevice)
+{
+	constexpr uint32_t reservedSamplers = 8; // other samplers bound next to material textures
+
+	const auto limits = physicalDevice.getProperties().limits;
+	const uint32_t maxSamplers = std::min({ limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages,
+		limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+
+	if (maxSamplers <= reservedSamplers)
+		throw std::runtime_error("Device sampler limit " + std::to_string(maxSamplers) + " is too low for material textures");
+
+	return std::min<uint32_t>(MAX_MATERIAL_TEXTURES, maxSamplers - reservedSamplers);
+}
+
 void Model::loadModel(Context& context, const std::string& path, const vk::Sampler& textureSampler,
-	const vk::DescriptorPool& descriptorPool, Resources& resources, ThreadPool& pool)
+	const vk::DescriptorPool& descriptorPool, Resources& resources, ThreadPool& pool, bool packedVertices)
 {
 	auto device = context.getDevice();
 	Utility utility(context);
 
+	mPackedVertices = packedVertices;
+	mVertexStride = packedVertices ? sizeof(util::PackedVertex) : sizeof(util::Vertex);
+	mPositionStride = util::getPositionBindingDescription(packedVertices).stride;
+
 	// load proxy texture
 	mImageAtlas[""] = utility.loadImageFromMemory({ 0, 0, 0, 0 }, 1, 1);
 
-	auto groups = loadModelFromFile(path);
+	WorkerStruct work(utility);
+	work.groups = loadModelFromFile(path);
 
-	vk::DeviceSize bufferSize = 0;
-	for (const auto& group : groups)
+	for (const auto& group : work.groups)
 	{
 		mImageAtlas[group.albedoMapPath];
 		mImageAtlas[group.normalMapPath];
 		mImageAtlas[group.specularMapPath];
+	}
 
-		if (group.indices.size() <= 0)
+	const uint32_t textureCount = getMaterialTextureCount(context.getPhysicalDevice());
+	if (mImageAtlas.size() > textureCount)
+		throw std::runtime_error("Too many material textures: " + std::to_string(mImageAtlas.size())
+			+ ", device supports " + std::to_string(textureCount));
+
+	// index textures in material texture array, proxy texture is always 0
+	std::unordered_map<std::string, uint32_t> textureIndices;
+	uint32_t textureCounter = 1;
+	for (const auto& image : mImageAtlas)
+		textureIndices[image.first] = image.first.empty() ? 0 : textureCounter++;
+
+	// lay out all parts into single vertex and index region
+	uint32_t indexCount = 0;
+	uint32_t vertexCount = 0;
+	for (size_t i = 0; i < work.groups.size(); i++)
+	{
+		const auto& group = work.groups[i];
+
+		if (group.indices.empty())
 			continue;
 
-		bufferSize += sizeof(util::Vertex) * group.vertices.size();
-		bufferSize += sizeof(uint32_t) * group.indices.size();
+		MeshPart part(group.lods[0].indexCount, indexCount, static_cast<int32_t>(vertexCount));
+		part.lodCount = static_cast<uint32_t>(group.lods.size());
+		part.boundingSphere = glm::vec4((group.bounds.min + group.bounds.max) * 0.5f, glm::length(group.bounds.max - group.bounds.min) * 0.5f);
+
+		for (size_t lod = 0; lod < group.lods.size(); lod++)
+		{
+			part.lods[lod] = group.lods[lod];
+			part.lods[lod].firstIndex += indexCount;
+		}
+
+		part.material.albedoMap = textureIndices[group.albedoMapPath];
+		part.material.normalMap = textureIndices[group.normalMapPath];
+		part.material.specularMap = textureIndices[group.specularMapPath];
+
+		mParts.emplace_back(part);
+		work.partGroupIndices.emplace_back(i);
+
+		indexCount += static_cast<uint32_t>(group.indices.size());
+		vertexCount += static_cast<uint32_t>(group.vertices.size());
 	}
 
+	vk::DeviceSize vertexSectionSize = mVertexStride * vertexCount;
+	vk::DeviceSize indexSectionSize = sizeof(uint32_t) * indexCount;
+	vk::DeviceSize positionSectionSize = mPositionStride * vertexCount;
+
 	mBuffer = utility.createBuffer(
-		bufferSize,
-		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer,
+		std::max(vertexSectionSize + indexSectionSize + positionSectionSize, vk::DeviceSize(1)),
+		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
 		vk::MemoryPropertyFlagBits::eDeviceLocal
 	);
 
-	WorkerStruct work(utility);
-	work.groups = std::move(groups);
+	mVertexBufferSection = { *mBuffer.handle, 0, vertexSectionSize };
+	mIndexBufferSection = { *mBuffer.handle, vertexSectionSize, indexSectionSize };
+	mPositionBufferSection = { *mBuffer.handle, vertexSectionSize + indexSectionSize, positionSectionSize };
+
 	work.stagingBuffer = utility.createBuffer(
 		1024 * 1024 * 1024, // 1 GB
 		vk::BufferUsageFlagBits::eTransferSrc,
@@ -313,10 +437,8 @@ void Model::loadModel(Context& context, const std::string& path, const vk::Sampl
 	pool.wait();
 
 	// copy data
-	mParts.resize(work.groups.size());
 	pool.addWorkMultiplex([this, &work](size_t id) { threadLoadData(id, work); });
 	pool.wait();
-	mParts.resize(work.partIndexCounter);
 
 	// retrieve command buffers
 	std::vector<vk::CommandBuffer> cmdBuffers;
@@ -327,65 +449,94 @@ void Model::loadModel(Context& context, const std::string& path, const vk::Sampl
 	cmd->begin(vk::CommandBufferBeginInfo());
 	cmd->executeCommands(cmdBuffers);
 
-	// decide min alignment for unform buffers
-	auto minAlignment = context.getPhysicalDevice().getProperties().limits.minUniformBufferOffsetAlignment;
-	vk::DeviceSize alignmentOffset = ((sizeof(MaterialUBO) - 1) / minAlignment + 1) * minAlignment;
+	// create draw commands, materials, bounds and meshlets, part index is passed as instance index
+	std::vector<vk::DrawIndexedIndirectCommand> drawCommands;
+	std::vector<Material> materials;
+	std::vector<PartBounds> bounds;
+	std::vector<MeshletGPU> meshlets;
+
+	for (uint32_t i = 0; i < mParts.size(); i++)
+	{
+		const auto& part = mParts[i];
+		const auto& group = work.groups[work.partGroupIndices[i]];
+
+		drawCommands.emplace_back(part.indexCount, 1, part.firstIndex, part.vertexOffset, i);
+		materials.emplace_back(part.material);
+		bounds.push_back({ glm::vec4(group.bounds.min, 0.0f), glm::vec4(group.bounds.max - group.bounds.min, 0.0f) });
 
-	// create uniforms buffer
-	mUniformBuffer = utility.createBuffer(
-		alignmentOffset * mParts.size(),
-		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eUniformBuffer,
+		for (uint32_t lod = 0; lod < part.lodCount; lod++)
+		{
+			for (uint32_t m = 0; m < group.lods[lod].meshletCount; m++)
+			{
+				const auto& meshlet = group.meshlets[group.lods[lod].firstMeshlet + m];
+				meshlets.push_back({ meshlet.boundingSphere, meshlet.cone, part.firstIndex + meshlet.firstIndex, meshlet.indexCount, part.vertexOffset, i << 2 | lod });
+			}
+		}
+	}
+
+	mMeshletCount = static_cast<uint32_t>(meshlets.size());
+
+	vk::DeviceSize indirectSize = sizeof(vk::DrawIndexedIndirectCommand) * std::max(drawCommands.size(), size_t(1));
+	vk::DeviceSize materialSize = sizeof(Material) * std::max(materials.size(), size_t(1));
+	vk::DeviceSize boundsSize = sizeof(PartBounds) * std::max(bounds.size(), size_t(1));
+	vk::DeviceSize meshletSize = sizeof(MeshletGPU) * std::max(meshlets.size(), size_t(1));
+	vk::DeviceSize meshletCommandSize = sizeof(vk::DrawIndexedIndirectCommand) * std::max(meshlets.size(), size_t(1));
+	vk::DeviceSize selectedLodSize = sizeof(uint32_t) * std::max(mParts.size(), size_t(1));
+
+	mIndirectBuffer = utility.createBuffer(
+		indirectSize,
+		vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+	);
+
+	mDrawCommands = static_cast<vk::DrawIndexedIndirectCommand*>(device.mapMemory(*mIndirectBuffer.memory, 0, VK_WHOLE_SIZE, {}));
+	memcpy(mDrawCommands, drawCommands.data(), sizeof(vk::DrawIndexedIndirectCommand) * drawCommands.size());
+
+	mMaterialBuffer = utility.createBuffer(
+		materialSize,
+		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
 		vk::MemoryPropertyFlagBits::eDeviceLocal
 	);
 
-	// create and update descriptor sets
-	vk::DeviceSize currentOffset = work.stagingBufferOffset;
-	vk::DeviceSize uniformStartOffset = currentOffset;
-	std::vector<vk::WriteDescriptorSet> descriptorWrites;
-	std::vector<vk::DescriptorBufferInfo> bufferInfos(mParts.size());
-	std::vector<vk::DescriptorImageInfo> imageInfos(mParts.size() * 3);
-	size_t counter = 0;
+	mBoundsBuffer = utility.createBuffer(
+		boundsSize,
+		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal
+	);
 
-	for (size_t i = 0; i < mParts.size(); i++)
-	{
-		auto& part = mParts[i];
+	mMeshletBuffer = utility.createBuffer(
+		meshletSize,
+		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal
+	);
 
-		part.materialDescriptorSetKey += std::to_string(counter++);
-		
-		vk::DescriptorSetAllocateInfo allocInfo;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = &resources.descriptorSetLayout.get("material");
-
-		const auto targetSet = resources.descriptorSet.add(part.materialDescriptorSetKey, allocInfo);
-		MaterialUBO ubo;
-
-		bufferInfos[i] = vk::DescriptorBufferInfo(*mUniformBuffer.handle, currentOffset - uniformStartOffset, alignmentOffset);
-		imageInfos[i * 3] = vk::DescriptorImageInfo(textureSampler, part.albedoMap, vk::ImageLayout::eShaderReadOnlyOptimal); 
-		imageInfos[i * 3 + 1] = vk::DescriptorImageInfo(textureSampler, part.normalMap, vk::ImageLayout::eShaderReadOnlyOptimal); 
-		imageInfos[i * 3 + 2] = vk::DescriptorImageInfo(textureSampler, part.specularMap, vk::ImageLayout::eShaderReadOnlyOptimal); 
-
-		descriptorWrites.emplace_back(util::createDescriptorWriteBuffer(targetSet, 0, vk::DescriptorType::eUniformBuffer, bufferInfos[i]));
-		descriptorWrites.emplace_back(util::createDescriptorWriteImage(targetSet, 1, imageInfos[i * 3]));
-		descriptorWrites.emplace_back(util::createDescriptorWriteImage(targetSet, 2, imageInfos[i * 3 + 1]));
-		descriptorWrites.emplace_back(util::createDescriptorWriteImage(targetSet, 3, imageInfos[i * 3 + 2]));
-
-		ubo.hasAlbedoMap = part.hasAlbedo;
-		ubo.hasNormalMap = part.hasNormal;
-		ubo.hasSpecularMap = part.hasSpecular;
-
-		memcpy(work.data + currentOffset, &ubo, sizeof(MaterialUBO));
-		currentOffset += alignmentOffset;
-	}
+	mMeshletCommandBuffer = utility.createBuffer(
+		meshletCommandSize,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal
+	);
 
-	utility.recordCopyBuffer(
-		*cmd, 
-		*work.stagingBuffer.handle,
-		*mUniformBuffer.handle,
-		alignmentOffset * mParts.size(),
-		uniformStartOffset
+	mSelectedLodBuffer = utility.createBuffer(
+		selectedLodSize,
+		vk::BufferUsageFlagBits::eStorageBuffer,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
 	);
 
+	mSelectedLods = static_cast<uint32_t*>(device.mapMemory(*mSelectedLodBuffer.memory, 0, VK_WHOLE_SIZE, {}));
+	memset(mSelectedLods, 0, selectedLodSize);
+
+	vk::DeviceSize currentOffset = work.stagingBufferOffset;
+	memcpy(work.data + currentOffset, materials.data(), sizeof(Material) * materials.size());
+	utility.recordCopyBuffer(*cmd, *work.stagingBuffer.handle, *mMaterialBuffer.handle, materialSize, currentOffset);
+
+	currentOffset += materialSize;
+	memcpy(work.data + currentOffset, bounds.data(), sizeof(PartBounds) * bounds.size());
+	utility.recordCopyBuffer(*cmd, *work.stagingBuffer.handle, *mBoundsBuffer.handle, boundsSize, currentOffset);
+
+	currentOffset += boundsSize;
+	memcpy(work.data + currentOffset, meshlets.data(), sizeof(MeshletGPU) * meshlets.size());
+	utility.recordCopyBuffer(*cmd, *work.stagingBuffer.handle, *mMeshletBuffer.handle, meshletSize, currentOffset);
+
 	cmd->end();
 
 	device.unmapMemory(*work.stagingBuffer.memory);
@@ -397,6 +548,56 @@ void Model::loadModel(Context& context, const std::string& path, const vk::Sampl
 	context.getGeneralQueue().submit(submitInfo, nullptr);
 	context.getGeneralQueue().waitIdle();
 
+	// create and update material descriptor set, unused texture slots point to proxy texture
+	vk::DescriptorSetAllocateInfo setAllocInfo;
+	setAllocInfo.descriptorPool = descriptorPool;
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &resources.descriptorSetLayout.get("material");
+
+	const auto targetSet = resources.descriptorSet.add("material", setAllocInfo);
+
+	std::vector<vk::DescriptorImageInfo> imageInfos(
+		textureCount,
+		vk::DescriptorImageInfo(textureSampler, *mImageAtlas[""].view, vk::ImageLayout::eShaderReadOnlyOptimal)
+	);
+
+	for (const auto& image : mImageAtlas)
+		imageInfos[textureIndices[image.first]].imageView = *image.second.view;
+
+	vk::DescriptorBufferInfo materialInfo(*mMaterialBuffer.handle, 0, materialSize);
+	vk::DescriptorBufferInfo boundsInfo(*mBoundsBuffer.handle, 0, boundsSize);
+	vk::DescriptorBufferInfo geometryInfo(*mBuffer.handle, 0, VK_WHOLE_SIZE); // visibility buffer resolve
+	vk::DescriptorBufferInfo drawCommandsInfo(*mIndirectBuffer.handle, 0, indirectSize);
+
+	vk::WriteDescriptorSet texturesWrite;
+	texturesWrite.dstSet = targetSet;
+	texturesWrite.dstBinding = 1;
+	texturesWrite.dstArrayElement = 0;
+	texturesWrite.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	texturesWrite.descriptorCount = textureCount;
+	texturesWrite.pImageInfo = imageInfos.data();
+
+	std::vector<vk::WriteDescriptorSet> descriptorWrites = 
+	{
+		util::createDescriptorWriteBuffer(targetSet, 0, vk::DescriptorType::eStorageBuffer, materialInfo),
+		texturesWrite,
+		util::createDescriptorWriteBuffer(targetSet, 2, vk::DescriptorType::eStorageBuffer, boundsInfo),
+		util::createDescriptorWriteBuffer(targetSet, 3, vk::DescriptorType::eStorageBuffer, geometryInfo),
+		util::createDescriptorWriteBuffer(targetSet, 4, vk::DescriptorType::eStorageBuffer, drawCommandsInfo)
+	};
+
+	// meshlet culling set
+	setAllocInfo.pSetLayouts = &resources.descriptorSetLayout.get("meshlets");
+	const auto meshletSet = resources.descriptorSet.add("meshlets", setAllocInfo);
+
+	vk::DescriptorBufferInfo meshletInfo(*mMeshletBuffer.handle, 0, meshletSize);
+	vk::DescriptorBufferInfo selectedLodInfo(*mSelectedLodBuffer.handle, 0, selectedLodSize);
+	vk::DescriptorBufferInfo meshletCommandInfo(*mMeshletCommandBuffer.handle, 0, meshletCommandSize);
+
+	descriptorWrites.emplace_back(util::createDescriptorWriteBuffer(meshletSet, 0, vk::DescriptorType::eStorageBuffer, meshletInfo));
+	descriptorWrites.emplace_back(util::createDescriptorWriteBuffer(meshletSet, 1, vk::DescriptorType::eStorageBuffer, selectedLodInfo));
+	descriptorWrites.emplace_back(util::createDescriptorWriteBuffer(meshletSet, 2, vk::DescriptorType::eStorageBuffer, meshletCommandInfo));
+
 	device.updateDescriptorSets(descriptorWrites, {});
 
 	work.commandBuffers.clear();
@@ -406,79 +607,63 @@ void Model::threadLoadData(size_t threadID, WorkerStruct& work)
 {
 	auto cmd = *work.commandBuffers[threadID];
 
-	for (size_t i = threadID; i < work.groups.size(); i += std::thread::hardware_concurrency()) 
+	for (size_t i = threadID; i < mParts.size(); i += std::thread::hardware_concurrency()) 
 	{
-		MeshMaterialGroup& group = work.groups[i];
-		
-		if (group.indices.empty())
-			continue;
+		const MeshPart& part = mParts[i];
+		const MeshMaterialGroup& group = work.groups[work.partGroupIndices[i]];
 
-		vk::DeviceSize vertexSectionSize = sizeof(util::Vertex) * group.vertices.size();
+		vk::DeviceSize vertexSectionSize = mVertexStride * group.vertices.size();
 		vk::DeviceSize indexSectionSize = sizeof(uint32_t) * group.indices.size();
+		vk::DeviceSize positionSectionSize = mPositionStride * group.vertices.size();
 
-		vk::DeviceSize stagingOffset = std::atomic_fetch_add(&work.stagingBufferOffset, vertexSectionSize + indexSectionSize);
-		vk::DeviceSize VIOffset = std::atomic_fetch_add(&work.VIBufferOffset, vertexSectionSize + indexSectionSize);
+		vk::DeviceSize stagingOffset = std::atomic_fetch_add(&work.stagingBufferOffset, vertexSectionSize + indexSectionSize + positionSectionSize);
 
-		// copy vertex data
-		BufferSection vertexBufferSection = { *mBuffer.handle, VIOffset, vertexSectionSize };
-		{
+		// copy vertex data, only the selected stream is uploaded
+		if (mPackedVertices)
+			memcpy(work.data + stagingOffset, group.packedVertices.data(), static_cast<size_t>(vertexSectionSize));
+		else
 			memcpy(work.data + stagingOffset, group.vertices.data(), static_cast<size_t>(vertexSectionSize));
 
-			work.utility.recordCopyBuffer(
-				cmd, 
-				*work.stagingBuffer.handle,
-				*mBuffer.handle,
-				vertexSectionSize,
-				stagingOffset,
-				VIOffset
-			);
-
-			stagingOffset += vertexSectionSize;
-			VIOffset += vertexSectionSize;
-		}
+		work.utility.recordCopyBuffer(
+			cmd, 
+			*work.stagingBuffer.handle,
+			*mBuffer.handle,
+			vertexSectionSize,
+			stagingOffset,
+			mVertexBufferSection.offset + mVertexStride * part.vertexOffset
+		);
 
-		// copy index data
-		BufferSection indexBufferSection = { *mBuffer.handle, VIOffset, indexSectionSize };
-		{
-			memcpy(work.data + stagingOffset, group.indices.data(), indexSectionSize);
-			
-			work.utility.recordCopyBuffer(
-				cmd,
-				*work.stagingBuffer.handle,
-				*mBuffer.handle,
-				indexSectionSize,
-				stagingOffset,
-				VIOffset
-			);
-		}
+		stagingOffset += vertexSectionSize;
 
-		MeshPart part(vertexBufferSection, indexBufferSection, static_cast<uint32_t>(group.indices.size()));
+		// copy index data
+		memcpy(work.data + stagingOffset, group.indices.data(), indexSectionSize);
+		
+		work.utility.recordCopyBuffer(
+			cmd,
+			*work.stagingBuffer.handle,
+			*mBuffer.handle,
+			indexSectionSize,
+			stagingOffset,
+			mIndexBufferSection.offset + sizeof(uint32_t) * part.firstIndex
+		);
 
-		if (!group.albedoMapPath.empty())
-		{
-			part.albedoMap = *mImageAtlas[group.albedoMapPath].view;
-			part.hasAlbedo = true;
-		}
-		else
-			part.albedoMap = *mImageAtlas[""].view;
+		stagingOffset += indexSectionSize;
 
-		if (!group.normalMapPath.empty())
+		// copy positions, packed stream keeps leading position and sign with color word
+		for (size_t v = 0; v < group.vertices.size(); v++)
 		{
-			part.normalMap = *mImageAtlas[group.normalMapPath].view;
-			part.hasNormal = true;
+			const void* source = mPackedVertices ? static_cast<const void*>(&group.packedVertices[v]) : static_cast<const void*>(&group.vertices[v].pos);
+			memcpy(work.data + stagingOffset + mPositionStride * v, source, static_cast<size_t>(mPositionStride));
 		}
-		else
-			part.normalMap = *mImageAtlas[""].view;
 
-		if (!group.specularMapPath.empty())
-		{
-			part.specularMap = *mImageAtlas[group.specularMapPath].view;
-			part.hasSpecular = true;
-		}
-		else
-			part.specularMap = *mImageAtlas[""].view;
-		
-		mParts[work.partIndexCounter++] = part;
+		work.utility.recordCopyBuffer(
+			cmd,
+			*work.stagingBuffer.handle,
+			*mBuffer.handle,
+			positionSectionSize,
+			stagingOffset,
+			mPositionBufferSection.offset + mPositionStride * part.vertexOffset
+		);
 	}
 
 	cmd.end();
@@ -537,3 +722,62 @@ const std::vector<MeshPart>& Model::getMeshParts() const
 {
 	return mParts;
 }
+
+bool Model::hasPackedVertices() const
+{
+	return mPackedVertices;
+}
+
+uint64_t Model::selectLods(const glm::vec3& cameraPosition, float projectionScale, float errorThreshold)
+{
+	uint64_t triangles = 0;
+
+	for (size_t i = 0; i < mParts.size(); i++)
+	{
+		const auto& part = mParts[i];
+
+		// projected error in pixels from closest point of bounding sphere
+		float distance = std::max(glm::length(glm::vec3(part.boundingSphere) - cameraPosition) - part.boundingSphere.w, 1e-4f);
+
+		uint32_t lod = 0;
+		while (lod + 1 < part.lodCount && part.lods[lod + 1].error * projectionScale / distance <= errorThreshold)
+			lod++;
+
+		mDrawCommands[i].firstIndex = part.lods[lod].firstIndex;
+		mDrawCommands[i].indexCount = part.lods[lod].indexCount;
+		mSelectedLods[i] = lod;
+		triangles += part.lods[lod].indexCount / 3;
+	}
+
+	return triangles;
+}
+
+uint32_t Model::getMeshletCount() const
+{
+	return mMeshletCount;
+}
+
+BufferSection Model::getMeshletCommandSection() const
+{
+	return { *mMeshletCommandBuffer.handle, 0, sizeof(vk::DrawIndexedIndirectCommand) * mMeshletCount };
+}
+
+BufferSection Model::getVertexBufferSection() const
+{
+	return mVertexBufferSection;
+}
+
+BufferSection Model::getIndexBufferSection() const
+{
+	return mIndexBufferSection;
+}
+
+BufferSection Model::getPositionBufferSection() const
+{
+	return mPositionBufferSection;
+}
+
+BufferSection Model::getIndirectBufferSection() const
+{
+	return { *mIndirectBuffer.handle, 0, sizeof(vk::DrawIndexedIndirectCommand) * mParts.size() };
+}
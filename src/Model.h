@@ -13,40 +13,70 @@
 #include "Util.h"
 #include "Resource.h"
 #include "ThreadPool.h"
+#include "MeshProcessing.h"
 #include <queue>
 #include <mutex>
 #include <atomic>
 
-struct MeshPart
+#define MAX_MATERIAL_TEXTURES 1024 // upper bound of material texture array, shaders get the clamped size as define
+#define MAX_MESH_LODS 4
+
+// Size of material texture array, MAX_MATERIAL_TEXTURES clamped to sampler limits of device
+uint32_t getMaterialTextureCount(vk::PhysicalDevice physicalDevice);
+
+struct Material // mirrors Material in gbuffers.frag
 {
-	BufferSection vertexBufferSection;
-	BufferSection indexBufferSection;
-	// BufferSection materialUniformSection;
+	uint32_t albedoMap = 0; // index to material texture array, 0 is proxy texture (no map)
+	uint32_t normalMap = 0;
+	uint32_t specularMap = 0;
+	uint32_t padding = 0;
+};
 
-	std::string materialDescriptorSetKey = "material.";
+struct PartBounds // mirrors PartBounds in gbuffers_packed.vert
+{
+	glm::vec4 min;
+	glm::vec4 extent;
+};
 
-	vk::ImageView albedoMap;
-	vk::ImageView normalMap;
-	vk::ImageView specularMap;
+struct MeshletGPU // mirrors Meshlet in meshlet_culling.comp
+{
+	glm::vec4 boundingSphere;
+	glm::vec4 cone;
+	uint32_t firstIndex; // absolute
+	uint32_t indexCount;
+	int32_t vertexOffset;
+	uint32_t partAndLod; // part index << 2 | lod
+};
 
-	bool hasAlbedo = false;
-	bool hasNormal = false;
-	bool hasSpecular = false;
+struct MeshPart
+{
+	uint32_t indexCount = 0; // full resolution
+	uint32_t firstIndex = 0; // offset in model index buffer
+	int32_t vertexOffset = 0; // offset in model vertex buffer
 
-	uint32_t indexCount = 0;
+	std::array<mesh::Lod, MAX_MESH_LODS> lods; // absolute index ranges, lod 0 is full resolution
+	uint32_t lodCount = 1;
+	glm::vec4 boundingSphere; // object space
+
+	Material material;
 	
 	MeshPart() = default;
-	MeshPart(const BufferSection& vertex, const BufferSection& index, uint32_t indexCount)
-		: vertexBufferSection(vertex)
-		, indexBufferSection(index)
-		, indexCount(indexCount)
+	MeshPart(uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset)
+		: indexCount(indexCount)
+		, firstIndex(firstIndex)
+		, vertexOffset(vertexOffset)
 	{}
 };
 
 struct MeshMaterialGroup // grouped by material
 {
 	std::vector<util::Vertex> vertices;
-	std::vector<uint32_t> indices;
+	std::vector<util::PackedVertex> packedVertices; // same order as vertices
+	std::vector<uint32_t> indices; // all lods, lod 0 first
+
+	std::vector<mesh::Lod> lods; // index ranges relative to group
+	std::vector<mesh::Meshlet> meshlets; // of all lods, index ranges relative to group
+	mesh::Bounds bounds;
 
 	std::string albedoMapPath;
 	std::string normalMapPath;
@@ -63,9 +93,8 @@ struct WorkerStruct
 	uint8_t* data;
 
 	BufferParameters stagingBuffer;
-	std::atomic<size_t> partIndexCounter = 0;
+	std::vector<size_t> partGroupIndices; // group index for every part
 	std::atomic<vk::DeviceSize> stagingBufferOffset = 0;
-	std::atomic<vk::DeviceSize> VIBufferOffset = 0;
 };
 
 class Model
@@ -80,9 +109,20 @@ public:
 	Model& operator=(Model&& model) = default;
 
 	void loadModel(Context& context, const std::string& path, const vk::Sampler& textureSampler,
-		const vk::DescriptorPool& descriptorPool, resource::Resources& resources, ThreadPool& pool);
+		const vk::DescriptorPool& descriptorPool, resource::Resources& resources, ThreadPool& pool, bool packedVertices);
 
 	const std::vector<MeshPart>& getMeshParts() const;
+	bool hasPackedVertices() const;
+
+	// Rewrites draw commands with coarsest lods under projected error threshold, returns drawn triangle count
+	uint64_t selectLods(const glm::vec3& cameraPosition, float projectionScale, float errorThreshold);
+
+	uint32_t getMeshletCount() const;
+	BufferSection getMeshletCommandSection() const; // written by meshlet culling
+	BufferSection getVertexBufferSection() const;
+	BufferSection getIndexBufferSection() const;
+	BufferSection getPositionBufferSection() const; // position only stream of depth prepass
+	BufferSection getIndirectBufferSection() const;
 
 private:
 	void threadLoadData(size_t threadID, WorkerStruct& work);
@@ -90,9 +130,25 @@ private:
 	
 private:
 	std::vector<MeshPart> mParts;
-
-	BufferParameters mBuffer;
-	BufferParameters mUniformBuffer;
+	bool mPackedVertices = false;
+	vk::DeviceSize mVertexStride = sizeof(util::Vertex);
+	vk::DeviceSize mPositionStride = sizeof(glm::vec3);
+
+	BufferParameters mBuffer; // all vertices followed by all indices and positions of vertices
+	BufferSection mVertexBufferSection;
+	BufferSection mIndexBufferSection;
+	BufferSection mPositionBufferSection;
+
+	BufferParameters mIndirectBuffer; // one draw command per part, host visible for lod selection
+	vk::DrawIndexedIndirectCommand* mDrawCommands = nullptr; // persistently mapped
+	BufferParameters mMaterialBuffer;
+	BufferParameters mBoundsBuffer; // dequantization of packed positions
+
+	uint32_t mMeshletCount = 0;
+	BufferParameters mMeshletBuffer;
+	BufferParameters mMeshletCommandBuffer;
+	BufferParameters mSelectedLodBuffer; // lod index per part, host visible
+	uint32_t* mSelectedLods = nullptr; // persistently mapped
 
 	std::unordered_map<std::string, ImageParameters> mImageAtlas;
 };
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.hpp>
 #include <algorithm> 
+#include <cmath>
 
 #include "Context.h"
 #include "Model.h"
@@ -19,7 +20,7 @@
 #include <valarray>
 #include <random>
 
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define MAX_ZBIN_MASK_SIZE (vk::DeviceSize(1) << 30) // bytes of z-bin tile masks, lights beyond it are dropped
 
 struct CameraUBO
 {
@@ -28,6 +29,15 @@ struct CameraUBO
 	glm::mat4 invProj;
 	glm::vec3 cameraPosition;
 	alignas(16) glm::uvec2 screenSize;
+	float zNear;
+	float zFar;
+	float sliceNear; // far bound of first cluster depth slice
+	float sliceScale; // log of depth ratio between neighbouring slices
+	uint32_t keyBitsX;
+	uint32_t keyBitsY;
+	uint32_t pageSizePower;
+	alignas(16) glm::vec3 lightBoundsMin; // view space bounds of quantized light positions
+	alignas(16) glm::vec3 lightBoundsExtent;
 };
 
 struct ObjectUBO
@@ -42,6 +52,12 @@ struct DebugUBO
 
 namespace
 {
+	// lights are sorted on compute queue, which then owns light buffer
+	bool sortsLights(CullingMethod method)
+	{
+		return method == CullingMethod::clustered || method == CullingMethod::zbin;
+	}
+
 	std::pair<vk::AttachmentDescription, vk::AttachmentReference> createAttachmentDescription(vk::Format format, vk::ImageLayout layout, uint32_t index)
 	{
 		vk::AttachmentDescription description;
@@ -75,6 +91,9 @@ Renderer::Renderer(GLFWwindow* window, Scene& scene)
 	mContext.getPhysicalDevice().getProperties2(&properties2);
 
 	mSubGroupSize = subgroupProperties.subgroupSize;
+	mFragmentSubgroupArithmetic = (subgroupProperties.supportedStages & vk::ShaderStageFlagBits::eFragment)
+		&& (subgroupProperties.supportedOperations & vk::SubgroupFeatureFlagBits::eArithmetic);
+	mVisibilityBufferSupported = mContext.getEnabledFeatures().geometryShader && mFragmentSubgroupArithmetic;
 	mLevelParam.reserve(6);
 
 	setTileCount();
@@ -98,13 +117,24 @@ Renderer::Renderer(GLFWwindow* window, Scene& scene)
 	// createGraphicsCommandBuffers();
 	createComputeCommandBuffer();
 	createSyncPrimitives();
+	createQueryPools();
 }
 
 void Renderer::draw()
 {
+	readQueryResults();
+	updateRenderScale();
 	updateUniformBuffers();
 
-	if (BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::clustered)
+	// z-bin masks are held only while z-binning is selected
+	if (BaseApp::getInstance().getUI().mContext.cullingMethod != CullingMethod::zbin && mZBinBuffer.handle)
+	{
+		mContext.getGeneralQueue().waitIdle();
+		mZBinBuffer = BufferParameters{};
+		mZBinMaskSize = 0;
+	}
+
+	if (sortsLights(BaseApp::getInstance().getUI().mContext.cullingMethod))
 		submitBVHCreationCmds(mCurrentFrame);
 
 	drawFrame();
@@ -117,12 +147,50 @@ void Renderer::cleanUp()
 
 void Renderer::reloadShaders(uint32_t tileSize)
 {
+	auto clusterLayout = glm::uvec4(mPageTableEntries, mPageSizePower, mTileCount);
 	mCurrentTileSize = tileSize;
 	setTileCount();
 
 	vkDeviceWaitIdle(mContext.getDevice());
 	mResource.pipeline.clear();
 
+	// G-buffer layout changed
+	const auto& context = BaseApp::getInstance().getUI().mContext;
+	bool lightVolumes = context.cullingMethod == CullingMethod::lightVolumes;
+	bool visibilityBuffer = useVisibilityBuffer();
+	bool depthPrepass = context.depthPrepass && !visibilityBuffer && context.compositionMode != CompositionMode::subpass; // merged pass always has one
+	uint32_t diffuseScale = 1;
+	if (context.compositionMode == CompositionMode::fragment && !lightVolumes)
+		diffuseScale = 1u << static_cast<uint32_t>(context.diffuseResolution[static_cast<size_t>(context.cullingMethod)]);
+
+	// light volumes test against G-buffer depth attached to composition pass, not scene pass
+	bool dynamicResolution = context.dynamicResolution && context.compositionMode == CompositionMode::fragment && !lightVolumes;
+
+	if (context.reconstructPosition != mReconstructPosition || context.reversedDepth != mReversedDepth || context.compositionMode != mCompositionMode || lightVolumes != mLightVolumes
+		|| visibilityBuffer != mVisibilityBuffer || depthPrepass != mDepthPrepass || diffuseScale != mDiffuseScale || dynamicResolution != mDynamicResolution)
+	{
+		mReconstructPosition = context.reconstructPosition;
+		mCompositionMode = context.compositionMode;
+		mLightVolumes = lightVolumes;
+		mVisibilityBuffer = visibilityBuffer;
+		mDepthPrepass = depthPrepass;
+		mDiffuseScale = diffuseScale;
+		mDynamicResolution = dynamicResolution;
+		mReversedDepth = context.reversedDepth;
+
+		if (!mDynamicResolution)
+			setRenderScale(1.0f);
+
+		createGBuffers();
+		createRenderPasses();
+		createFrameBuffers();
+	}
+
+	// page table follows cluster key width and unique cluster list tile count, other toggles keep cluster buffers
+	if (clusterLayout != glm::uvec4(mPageTableEntries, mPageSizePower, mTileCount))
+		createClusteredBuffers();
+	updateDescriptorSets();
+
 	createGraphicsPipelines();
 	createGraphicsCommandBuffers();
 	createComputePipeline();
@@ -132,7 +200,11 @@ void Renderer::reloadShaders(uint32_t tileSize)
 
 void Renderer::onSceneChange()
 {
-	createGraphicsCommandBuffers();
+	// triangle IDs of new scene may not fit, or fit again
+	if (useVisibilityBuffer() != mVisibilityBuffer)
+		reloadShaders(mCurrentTileSize);
+	else
+		createGraphicsCommandBuffers();
 
 	// update scale
 	{ 
@@ -159,6 +231,7 @@ void Renderer::recreateSwapChain()
 	createSwapChainImageViews();
 	createGBuffers();
 	createFrameBuffers();
+	createClusteredBuffers(); // page table follows cluster key width
 	updateDescriptorSets();
 	createGraphicsPipelines();
 	createGraphicsCommandBuffers();
@@ -199,6 +272,7 @@ void Renderer::createSwapChain()
 	mSwapchainImages = mContext.getDevice().getSwapchainImagesKHR(*mSwapchain);
 	mSwapchainImageFormat = surfaceFormat.format;
 	mSwapchainExtent = extent;
+	setRenderScale(mRenderScale); // scale is kept over resize
 }
 
 void Renderer::createSwapChainImageViews()
@@ -210,37 +284,117 @@ void Renderer::createSwapChainImageViews()
 
 void Renderer::createRenderPasses()
 {
-	// Gbuffer renderpass
+	createGBufferRenderPass();
+
+	// composition + UI
 	{
-		// attachment descriptions
-		auto position = createAttachmentDescription(mGBufferAttachments.position.format, vk::ImageLayout::eColorAttachmentOptimal, 0);
-		auto color = createAttachmentDescription(mGBufferAttachments.color.format, vk::ImageLayout::eColorAttachmentOptimal, 1);
-		auto normal = createAttachmentDescription(mGBufferAttachments.normal.format, vk::ImageLayout::eColorAttachmentOptimal, 2);
-		auto depth = createAttachmentDescription(mGBufferAttachments.depth.format, vk::ImageLayout::eDepthStencilAttachmentOptimal, 3);
+		vk::AttachmentDescription colorAttachmentComposition;
+		colorAttachmentComposition.format = mSwapchainImageFormat;
+		colorAttachmentComposition.samples = vk::SampleCountFlagBits::e1;
+		colorAttachmentComposition.loadOp = vk::AttachmentLoadOp::eDontCare; // before rendering
+		colorAttachmentComposition.storeOp = vk::AttachmentStoreOp::eStore; // after rendering
+		colorAttachmentComposition.stencilLoadOp = vk::AttachmentLoadOp::eDontCare; // no stencil
+		colorAttachmentComposition.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+		colorAttachmentComposition.initialLayout = vk::ImageLayout::eUndefined;
+		colorAttachmentComposition.finalLayout = vk::ImageLayout::ePresentSrcKHR; // to be directly used in swap chain
+
+		// G-buffer depth, light volumes are depth tested against it while it is still sampled
+		vk::AttachmentDescription depthAttachment;
+		depthAttachment.format = mGBufferAttachments.depth.format;
+		depthAttachment.samples = vk::SampleCountFlagBits::e1;
+		depthAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+		depthAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+		depthAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+		depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+		depthAttachment.initialLayout = getSampledDepthLayout();
+		depthAttachment.finalLayout = getSampledDepthLayout();
+
+		vk::AttachmentReference colorAttachmentRef;
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = vk::ImageLayout::eColorAttachmentOptimal;
+
+		vk::AttachmentReference depthAttachmentRef;
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
 		
-		std::vector<vk::AttachmentDescription> attachmentDescriptions = {position.first, color.first, normal.first, depth.first};
-		std::vector<vk::AttachmentReference> attachmentReferences = {position.second, color.second, normal.second, depth.second};
+		std::array<vk::SubpassDescription, 2> subpass;
+		subpass[0].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		subpass[0].colorAttachmentCount = 1;
+		subpass[0].pColorAttachments = &colorAttachmentRef;
+		subpass[0].pDepthStencilAttachment = mLightVolumes ? &depthAttachmentRef : nullptr;
+
+		subpass[1].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		subpass[1].colorAttachmentCount = 1;
+		subpass[1].pColorAttachments = &colorAttachmentRef;
+
+		std::array<vk::SubpassDependency, 3> dependencies;
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
+		dependencies[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+		dependencies[0].srcAccessMask = vk::AccessFlagBits::eMemoryRead;
+		dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead;
+		dependencies[0].dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = 1;
+		dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eFragmentShader;
+		dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		dependencies[1].dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+		dependencies[2].srcSubpass = 1;
+		dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[2].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		dependencies[2].dstStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
+		dependencies[2].srcAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[2].dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+		dependencies[2].dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+		std::vector<vk::AttachmentDescription> attachmentDescriptions = { colorAttachmentComposition };
+		if (mLightVolumes)
+			attachmentDescriptions.emplace_back(depthAttachment);
+
+		vk::RenderPassCreateInfo renderpassInfo;
+		renderpassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+		renderpassInfo.pAttachments = attachmentDescriptions.data();
+		renderpassInfo.subpassCount = static_cast<uint32_t>(subpass.size());
+		renderpassInfo.pSubpasses = subpass.data();
+		renderpassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderpassInfo.pDependencies = dependencies.data();
+
+		mCompositionRenderpass = mContext.getDevice().createRenderPassUnique(renderpassInfo);
+	}
+
+	// reduced resolution diffuse lighting, sampled by composition right after
+	{
+		auto irradiance = createAttachmentDescription(vk::Format::eR16G16B16A16Sfloat, vk::ImageLayout::eColorAttachmentOptimal, 0);
+		auto normal = createAttachmentDescription(vk::Format::eR16G16Sfloat, vk::ImageLayout::eColorAttachmentOptimal, 1);
+		irradiance.first.loadOp = normal.first.loadOp = vk::AttachmentLoadOp::eDontCare; // every texel is shaded
+
+		std::array<vk::AttachmentDescription, 2> attachmentDescriptions = { irradiance.first, normal.first };
+		std::array<vk::AttachmentReference, 2> attachmentReferences = { irradiance.second, normal.second };
 
 		vk::SubpassDescription subpass;
 		subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-		subpass.colorAttachmentCount = static_cast<uint32_t>(attachmentDescriptions.size() - 1);
+		subpass.colorAttachmentCount = static_cast<uint32_t>(attachmentReferences.size());
 		subpass.pColorAttachments = attachmentReferences.data();
-		subpass.pDepthStencilAttachment = &attachmentReferences.back();
 
 		std::array<vk::SubpassDependency, 2> dependencies;
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
+		dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eFragmentShader;
 		dependencies[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-		dependencies[0].srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-		dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[0].srcAccessMask = vk::AccessFlagBits::eShaderRead;
+		dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
 		dependencies[0].dependencyFlags = vk::DependencyFlagBits::eByRegion;
 		dependencies[1].srcSubpass = 0;
 		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-		dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
-		dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
-		dependencies[1].dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+		dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eFragmentShader;
+		dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
 		dependencies[1].dependencyFlags = vk::DependencyFlagBits::eByRegion;
 
 		vk::RenderPassCreateInfo renderpassInfo;
@@ -251,42 +405,261 @@ void Renderer::createRenderPasses()
 		renderpassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderpassInfo.pDependencies = dependencies.data();
 
-		mGBufferRenderpass = mContext.getDevice().createRenderPassUnique(renderpassInfo);
+		mDiffuseRenderpass = mContext.getDevice().createRenderPassUnique(renderpassInfo);
 	}
 
-	// composition + UI
+	// scene color of dynamic resolution, composition covers render extent and upscale pass samples it
 	{
-		vk::AttachmentDescription colorAttachmentComposition;
-		colorAttachmentComposition.format = mSwapchainImageFormat;
-		colorAttachmentComposition.samples = vk::SampleCountFlagBits::e1;
-		colorAttachmentComposition.loadOp = vk::AttachmentLoadOp::eDontCare; // before rendering
-		colorAttachmentComposition.storeOp = vk::AttachmentStoreOp::eStore; // after rendering
-		colorAttachmentComposition.stencilLoadOp = vk::AttachmentLoadOp::eDontCare; // no stencil
-		colorAttachmentComposition.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-		colorAttachmentComposition.initialLayout = vk::ImageLayout::eUndefined;
-		colorAttachmentComposition.finalLayout = vk::ImageLayout::ePresentSrcKHR; // to be directly used in swap chain
+		auto color = createAttachmentDescription(vk::Format::eR16G16B16A16Sfloat, vk::ImageLayout::eColorAttachmentOptimal, 0);
+		color.first.loadOp = vk::AttachmentLoadOp::eDontCare; // area outside render extent is never sampled
 
-		vk::AttachmentReference colorAttachmentRef;
-		colorAttachmentRef.attachment = 0;
-		colorAttachmentRef.layout = vk::ImageLayout::eColorAttachmentOptimal;
-		
-		std::array<vk::SubpassDescription, 2> subpass;
+		vk::SubpassDescription subpass;
+		subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &color.second;
+
+		std::array<vk::SubpassDependency, 2> dependencies;
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eFragmentShader;
+		dependencies[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		dependencies[0].srcAccessMask = vk::AccessFlagBits::eShaderRead;
+		dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[0].dependencyFlags = vk::DependencyFlagBits::eByRegion;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eFragmentShader;
+		dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		vk::RenderPassCreateInfo renderpassInfo;
+		renderpassInfo.attachmentCount = 1;
+		renderpassInfo.pAttachments = &color.first;
+		renderpassInfo.subpassCount = 1;
+		renderpassInfo.pSubpasses = &subpass;
+		renderpassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderpassInfo.pDependencies = dependencies.data();
+
+		mSceneRenderpass = mContext.getDevice().createRenderPassUnique(renderpassInfo);
+	}
+
+	createMergedRenderPass();
+}
+
+void Renderer::createGBufferRenderPass()
+{
+	// attachment descriptions, position is left unused when reconstructed from depth
+	auto position = createAttachmentDescription(mGBufferAttachments.position.format, vk::ImageLayout::eColorAttachmentOptimal, 0);
+	auto color = createAttachmentDescription(mGBufferAttachments.color.format, vk::ImageLayout::eColorAttachmentOptimal, 1);
+	auto normal = createAttachmentDescription(mGBufferAttachments.normal.format, vk::ImageLayout::eColorAttachmentOptimal, 2);
+	auto depth = createAttachmentDescription(mGBufferAttachments.depth.format, vk::ImageLayout::eDepthStencilAttachmentOptimal, 3);
+	
+	std::vector<vk::AttachmentDescription> attachmentDescriptions = {position.first, color.first, normal.first, depth.first};
+	std::vector<vk::AttachmentReference> attachmentReferences = {position.second, color.second, normal.second, depth.second};
+
+	if (mReconstructPosition)
+	{
+		attachmentDescriptions.erase(attachmentDescriptions.begin());
+		attachmentReferences[0].attachment = VK_ATTACHMENT_UNUSED;
+		for (size_t i = 1; i < attachmentReferences.size(); i++)
+			attachmentReferences[i].attachment--;
+	}
+
+	// depth of prepass is loaded and stays read only, light culling samples it meanwhile
+	if (mDepthPrepass)
+	{
+		auto& depthDescription = attachmentDescriptions.back();
+		depthDescription.loadOp = vk::AttachmentLoadOp::eLoad;
+		depthDescription.initialLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+		depthDescription.finalLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+		attachmentReferences.back().layout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+	}
+
+	std::vector<vk::SubpassDescription> subpasses(1);
+	subpasses[0].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+	subpasses[0].colorAttachmentCount = static_cast<uint32_t>(attachmentReferences.size() - 1);
+	subpasses[0].pColorAttachments = attachmentReferences.data();
+	subpasses[0].pDepthStencilAttachment = &attachmentReferences.back();
+
+	// visibility buffer, first subpass rasterizes triangle IDs with depth, second resolves G-buffer of visible pixels
+	vk::AttachmentReference visibilityReference;
+	vk::AttachmentReference visibilityInputReference;
+
+	if (mVisibilityBuffer)
+	{
+		auto visibility = createAttachmentDescription(mGBufferAttachments.visibility.format, vk::ImageLayout::eColorAttachmentOptimal, static_cast<uint32_t>(attachmentDescriptions.size()));
+		visibility.first.storeOp = vk::AttachmentStoreOp::eDontCare;
+		attachmentDescriptions.emplace_back(visibility.first);
+
+		visibilityReference = visibility.second;
+		visibilityInputReference = vk::AttachmentReference(visibility.second.attachment, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		subpasses.emplace_back(subpasses[0]);
+		subpasses[0].colorAttachmentCount = 1;
+		subpasses[0].pColorAttachments = &visibilityReference;
+
+		subpasses[1].pDepthStencilAttachment = nullptr;
+		subpasses[1].inputAttachmentCount = 1;
+		subpasses[1].pInputAttachments = &visibilityInputReference;
+	}
+
+	std::vector<vk::SubpassDependency> dependencies(2);
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
+	dependencies[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	dependencies[0].srcAccessMask = vk::AccessFlagBits::eMemoryRead;
+	dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+	dependencies[0].dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+	if (mDepthPrepass)
+	{
+		dependencies[0].srcStageMask |= vk::PipelineStageFlagBits::eLateFragmentTests;
+		dependencies[0].dstStageMask |= vk::PipelineStageFlagBits::eEarlyFragmentTests;
+		dependencies[0].srcAccessMask |= vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+		dependencies[0].dstAccessMask |= vk::AccessFlagBits::eDepthStencilAttachmentRead;
+	}
+
+	dependencies[1].srcSubpass = static_cast<uint32_t>(subpasses.size() - 1);
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
+	dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+	dependencies[1].dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+	dependencies[1].dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+	if (mVisibilityBuffer)
+	{
+		vk::SubpassDependency resolve;
+		resolve.srcSubpass = 0;
+		resolve.dstSubpass = 1;
+		resolve.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		resolve.dstStageMask = vk::PipelineStageFlagBits::eFragmentShader;
+		resolve.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+		resolve.dstAccessMask = vk::AccessFlagBits::eInputAttachmentRead;
+		resolve.dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+		dependencies.emplace_back(resolve);
+	}
+
+	vk::RenderPassCreateInfo renderpassInfo;
+	renderpassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+	renderpassInfo.pAttachments = attachmentDescriptions.data();
+	renderpassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+	renderpassInfo.pSubpasses = subpasses.data();
+	renderpassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderpassInfo.pDependencies = dependencies.data();
+
+	mGBufferRenderpass = mContext.getDevice().createRenderPassUnique(renderpassInfo);
+}
+
+void Renderer::createMergedRenderPass()
+{
+	// depth prepass, depth is sampled by light culling and loaded by merged pass
+	{
+		auto depth = createAttachmentDescription(mGBufferAttachments.depth.format, vk::ImageLayout::eDepthStencilAttachmentOptimal, 0);
+		depth.first.finalLayout = getSampledDepthLayout();
+
+		vk::SubpassDescription subpass;
+		subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		subpass.pDepthStencilAttachment = &depth.second;
+
+		std::array<vk::SubpassDependency, 2> dependencies;
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+		dependencies[0].dstStageMask = vk::PipelineStageFlagBits::eEarlyFragmentTests;
+		dependencies[0].srcAccessMask = vk::AccessFlagBits::eShaderRead;
+		dependencies[0].dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+		dependencies[0].dependencyFlags = vk::DependencyFlagBits::eByRegion;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eLateFragmentTests;
+		dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+		dependencies[1].srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+		dependencies[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		dependencies[1].dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+		vk::RenderPassCreateInfo renderpassInfo;
+		renderpassInfo.attachmentCount = 1;
+		renderpassInfo.pAttachments = &depth.first;
+		renderpassInfo.subpassCount = 1;
+		renderpassInfo.pSubpasses = &subpass;
+		renderpassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderpassInfo.pDependencies = dependencies.data();
+
+		mDepthPrepassRenderpass = mContext.getDevice().createRenderPassUnique(renderpassInfo);
+	}
+
+	// G-buffer + composition + UI, G-buffer stays in tile memory and is read as input attachments
+	{
+		vk::AttachmentDescription swapchain;
+		swapchain.format = mSwapchainImageFormat;
+		swapchain.samples = vk::SampleCountFlagBits::e1;
+		swapchain.loadOp = vk::AttachmentLoadOp::eDontCare;
+		swapchain.storeOp = vk::AttachmentStoreOp::eStore;
+		swapchain.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+		swapchain.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+		swapchain.initialLayout = vk::ImageLayout::eUndefined;
+		swapchain.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+
+		auto position = createAttachmentDescription(mGBufferAttachments.position.format, vk::ImageLayout::eColorAttachmentOptimal, 1);
+		auto color = createAttachmentDescription(mGBufferAttachments.color.format, vk::ImageLayout::eColorAttachmentOptimal, 2);
+		auto normal = createAttachmentDescription(mGBufferAttachments.normal.format, vk::ImageLayout::eColorAttachmentOptimal, 3);
+		auto depth = createAttachmentDescription(mGBufferAttachments.depth.format, vk::ImageLayout::eDepthStencilReadOnlyOptimal, 4);
+
+		// G-buffer is not needed after composition, depth is written by prepass
+		for (auto* description : { &position.first, &color.first, &normal.first })
+		{
+			description->storeOp = vk::AttachmentStoreOp::eDontCare;
+			description->finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+		}
+
+		depth.first.loadOp = vk::AttachmentLoadOp::eLoad;
+		depth.first.initialLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+		std::vector<vk::AttachmentDescription> attachmentDescriptions = { swapchain, position.first, color.first, normal.first, depth.first };
+		std::vector<vk::AttachmentReference> gBufferReferences = { position.second, color.second, normal.second, depth.second };
+
+		if (mReconstructPosition)
+		{
+			attachmentDescriptions.erase(attachmentDescriptions.begin() + 1);
+			gBufferReferences[0].attachment = VK_ATTACHMENT_UNUSED;
+			for (size_t i = 1; i < gBufferReferences.size(); i++)
+				gBufferReferences[i].attachment--;
+		}
+
+		std::vector<vk::AttachmentReference> inputReferences = gBufferReferences;
+		for (size_t i = 0; i < inputReferences.size() - 1; i++)
+			inputReferences[i].layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+		vk::AttachmentReference swapchainReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+
+		std::array<vk::SubpassDescription, 3> subpass;
 		subpass[0].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-		subpass[0].colorAttachmentCount = 1;
-		subpass[0].pColorAttachments = &colorAttachmentRef;
-		// subpass.pDepthStencilAttachment = &depthAttachmentRef;
+		subpass[0].colorAttachmentCount = static_cast<uint32_t>(gBufferReferences.size() - 1);
+		subpass[0].pColorAttachments = gBufferReferences.data();
+		subpass[0].pDepthStencilAttachment = &gBufferReferences.back();
 
 		subpass[1].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		subpass[1].inputAttachmentCount = static_cast<uint32_t>(inputReferences.size());
+		subpass[1].pInputAttachments = inputReferences.data();
 		subpass[1].colorAttachmentCount = 1;
-		subpass[1].pColorAttachments = &colorAttachmentRef;
+		subpass[1].pColorAttachments = &swapchainReference;
+		subpass[1].pDepthStencilAttachment = mLightVolumes ? &gBufferReferences.back() : nullptr; // read only, same layout as input
 
-		std::array<vk::SubpassDependency, 3> dependencies;
+		subpass[2].pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		subpass[2].colorAttachmentCount = 1;
+		subpass[2].pColorAttachments = &swapchainReference;
+
+		std::array<vk::SubpassDependency, 4> dependencies;
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
 		dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
-		dependencies[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		dependencies[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
 		dependencies[0].srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-		dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead;
 		dependencies[0].dependencyFlags = vk::DependencyFlagBits::eByRegion;
 
 		dependencies[1].srcSubpass = 0;
@@ -294,18 +667,24 @@ void Renderer::createRenderPasses()
 		dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
 		dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eFragmentShader;
 		dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-		dependencies[1].dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		dependencies[1].dstAccessMask = vk::AccessFlagBits::eInputAttachmentRead;
 		dependencies[1].dependencyFlags = vk::DependencyFlagBits::eByRegion;
 
 		dependencies[2].srcSubpass = 1;
-		dependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[2].dstSubpass = 2;
 		dependencies[2].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-		dependencies[2].dstStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
-		dependencies[2].srcAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
-		dependencies[2].dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+		dependencies[2].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		dependencies[2].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[2].dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
 		dependencies[2].dependencyFlags = vk::DependencyFlagBits::eByRegion;
 
-		std::array<vk::AttachmentDescription, 1> attachmentDescriptions = { colorAttachmentComposition/*, depthAttachment*/ };
+		dependencies[3].srcSubpass = 2;
+		dependencies[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[3].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		dependencies[3].dstStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
+		dependencies[3].srcAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+		dependencies[3].dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+		dependencies[3].dependencyFlags = vk::DependencyFlagBits::eByRegion;
 
 		vk::RenderPassCreateInfo renderpassInfo;
 		renderpassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
@@ -315,7 +694,7 @@ void Renderer::createRenderPasses()
 		renderpassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 		renderpassInfo.pDependencies = dependencies.data();
 
-		mCompositionRenderpass = mContext.getDevice().createRenderPassUnique(renderpassInfo);
+		mMergedRenderpass = mContext.getDevice().createRenderPassUnique(renderpassInfo);
 	}
 }
 
@@ -324,12 +703,17 @@ void Renderer::createFrameBuffers()
 	// gbuffers
 	{
 		std::vector<vk::ImageView> attachments = {
-			*mGBufferAttachments.position.view,
 			*mGBufferAttachments.color.view,
 			*mGBufferAttachments.normal.view,
 			*mGBufferAttachments.depth.view
 		};
 
+		if (!mReconstructPosition)
+			attachments.insert(attachments.begin(), *mGBufferAttachments.position.view);
+
+		if (mVisibilityBuffer)
+			attachments.emplace_back(*mGBufferAttachments.visibility.view);
+
 		vk::FramebufferCreateInfo framebufferInfo;
 		framebufferInfo.renderPass = *mGBufferRenderpass;
 		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
@@ -341,6 +725,81 @@ void Renderer::createFrameBuffers()
 		mGBufferFramebuffer = mContext.getDevice().createFramebufferUnique(framebufferInfo);
 	}
 
+	// reduced resolution diffuse lighting
+	mDiffuseFramebuffer.reset();
+	if (mDiffuseScale > 1)
+	{
+		std::array<vk::ImageView, 2> attachments = { *mDiffuseImage.view, *mDiffuseNormal.view };
+		auto extent = getDiffuseExtent(mSwapchainExtent);
+
+		vk::FramebufferCreateInfo framebufferInfo;
+		framebufferInfo.renderPass = *mDiffuseRenderpass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
+		framebufferInfo.width = extent.width;
+		framebufferInfo.height = extent.height;
+		framebufferInfo.layers = 1;
+
+		mDiffuseFramebuffer = mContext.getDevice().createFramebufferUnique(framebufferInfo);
+	}
+
+	// scene color of dynamic resolution
+	mSceneFramebuffer.reset();
+	if (mDynamicResolution)
+	{
+		vk::FramebufferCreateInfo framebufferInfo;
+		framebufferInfo.renderPass = *mSceneRenderpass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &*mSceneColor.view;
+		framebufferInfo.width = mSwapchainExtent.width;
+		framebufferInfo.height = mSwapchainExtent.height;
+		framebufferInfo.layers = 1;
+
+		mSceneFramebuffer = mContext.getDevice().createFramebufferUnique(framebufferInfo);
+	}
+
+	// depth prepass
+	{
+		vk::FramebufferCreateInfo framebufferInfo;
+		framebufferInfo.renderPass = *mDepthPrepassRenderpass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &*mGBufferAttachments.depth.view;
+		framebufferInfo.width = mSwapchainExtent.width;
+		framebufferInfo.height = mSwapchainExtent.height;
+		framebufferInfo.layers = 1;
+
+		mDepthPrepassFramebuffer = mContext.getDevice().createFramebufferUnique(framebufferInfo);
+	}
+
+	// merged
+	{
+		mMergedFramebuffers.clear();
+		mMergedFramebuffers.reserve(mSwapchainImageViews.size());
+
+		for (const auto& view : mSwapchainImageViews)
+		{
+			std::vector<vk::ImageView> attachments = {
+				*view,
+				*mGBufferAttachments.color.view,
+				*mGBufferAttachments.normal.view,
+				*mGBufferAttachments.depth.view
+			};
+
+			if (!mReconstructPosition)
+				attachments.insert(attachments.begin() + 1, *mGBufferAttachments.position.view);
+
+			vk::FramebufferCreateInfo framebufferInfo;
+			framebufferInfo.renderPass = *mMergedRenderpass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments = attachments.data();
+			framebufferInfo.width = mSwapchainExtent.width;
+			framebufferInfo.height = mSwapchainExtent.height;
+			framebufferInfo.layers = 1;
+
+			mMergedFramebuffers.emplace_back(mContext.getDevice().createFramebufferUnique(framebufferInfo));
+		}
+	}
+
 	// composition
 	{
 		mSwapchainFramebuffers.clear();
@@ -349,6 +808,8 @@ void Renderer::createFrameBuffers()
 		for (const auto& view : mSwapchainImageViews)
 		{
 			std::vector<vk::ImageView> attachments = { *view };
+			if (mLightVolumes)
+				attachments.emplace_back(*mGBufferAttachments.depth.view);
 
 			vk::FramebufferCreateInfo framebufferInfo;
 			framebufferInfo.renderPass = *mCompositionRenderpass;
@@ -388,7 +849,7 @@ void Renderer::createDescriptorSetLayouts()
 		uboBinding.binding = 0;
 		uboBinding.descriptorType = vk::DescriptorType::eUniformBuffer;
 		uboBinding.descriptorCount = 1;
-		uboBinding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+		uboBinding.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
 
 		vk::DescriptorSetLayoutCreateInfo createInfo;
 		createInfo.bindingCount = 1;
@@ -399,31 +860,39 @@ void Renderer::createDescriptorSetLayouts()
 
 	// Material
 	{
-		vk::DescriptorSetLayoutBinding uboBinding;
-		uboBinding.binding = 0;
-		uboBinding.descriptorType = vk::DescriptorType::eUniformBuffer;
-		uboBinding.descriptorCount = 1;
-		uboBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
-
-		vk::DescriptorSetLayoutBinding albedoBinding;
-		albedoBinding.binding = 1;
-		albedoBinding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-		albedoBinding.descriptorCount = 1;
-		albedoBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
-
-		vk::DescriptorSetLayoutBinding normalBinding;
-		normalBinding.binding = 2;
-		normalBinding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-		normalBinding.descriptorCount = 1;
-		normalBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
-
-		vk::DescriptorSetLayoutBinding specularBinding;
-		specularBinding.binding = 3;
-		specularBinding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-		specularBinding.descriptorCount = 1;
-		specularBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
-
-		std::array<vk::DescriptorSetLayoutBinding, 4> bindings = { uboBinding, albedoBinding, normalBinding, specularBinding };
+		vk::DescriptorSetLayoutBinding materialBinding;
+		materialBinding.binding = 0;
+		materialBinding.descriptorType = vk::DescriptorType::eStorageBuffer;
+		materialBinding.descriptorCount = 1;
+		materialBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+		vk::DescriptorSetLayoutBinding texturesBinding;
+		texturesBinding.binding = 1;
+		texturesBinding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+		texturesBinding.descriptorCount = getMaterialTextureCount(mContext.getPhysicalDevice());
+		texturesBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+		vk::DescriptorSetLayoutBinding boundsBinding;
+		boundsBinding.binding = 2;
+		boundsBinding.descriptorType = vk::DescriptorType::eStorageBuffer;
+		boundsBinding.descriptorCount = 1;
+		boundsBinding.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
+		// vertices and indices, fetched by visibility buffer resolve
+		vk::DescriptorSetLayoutBinding geometryBinding;
+		geometryBinding.binding = 3;
+		geometryBinding.descriptorType = vk::DescriptorType::eStorageBuffer;
+		geometryBinding.descriptorCount = 1;
+		geometryBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+		// draw commands of parts, index ranges of selected lods
+		vk::DescriptorSetLayoutBinding drawCommandsBinding;
+		drawCommandsBinding.binding = 4;
+		drawCommandsBinding.descriptorType = vk::DescriptorType::eStorageBuffer;
+		drawCommandsBinding.descriptorCount = 1;
+		drawCommandsBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+		std::array<vk::DescriptorSetLayoutBinding, 5> bindings = { materialBinding, texturesBinding, boundsBinding, geometryBinding, drawCommandsBinding };
 
 		vk::DescriptorSetLayoutCreateInfo createInfo;
 		createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -432,14 +901,31 @@ void Renderer::createDescriptorSetLayouts()
 		mResource.descriptorSetLayout.add("material", createInfo);
 	}
 
-	// Light culling
+	// Meshlet culling
 	{
 		std::vector<vk::DescriptorSetLayoutBinding> bindings;
-
-		// point lights
+		// meshlets
 		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
-
-		// lights out
+		// selected lods
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+		// draw commands
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+
+		vk::DescriptorSetLayoutCreateInfo createInfo;
+		createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		createInfo.pBindings = bindings.data();
+
+		mResource.descriptorSetLayout.add("meshlets", createInfo);
+	}
+
+	// Light culling
+	{
+		std::vector<vk::DescriptorSetLayoutBinding> bindings;
+
+		// point lights
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+
+		// lights out
 		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
 		
 		// lights indirection
@@ -457,6 +943,21 @@ void Renderer::createDescriptorSetLayouts()
 		// unique clusters
 		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
 
+		// cluster statistics
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+
+		// packed light volumes
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+
+		// packed light intensities
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+
+		// packed spot cones
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+
+		// merged lights of BVH nodes
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+
 		vk::DescriptorSetLayoutCreateInfo createInfo;
 		createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 		createInfo.pBindings = bindings.data();
@@ -467,36 +968,53 @@ void Renderer::createDescriptorSetLayouts()
 	// Composition
 	{
 		std::vector<vk::DescriptorSetLayoutBinding> bindings;
+		auto compositionStages = vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
 		
-		// point lights
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment);
+		// point lights, light volumes are placed by vertex shader
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages | vk::ShaderStageFlagBits::eVertex);
 
 		// lights out
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
 
 		// lights indirection
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
 
 		// position
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, compositionStages);
 
 		// albedo
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, compositionStages);
 
 		// normal
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, compositionStages);
 
 		// depth
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, compositionStages);
 		
 		// page table
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
 
 		// page pool
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
 
 		// unique clusters
-		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eFragment);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
+
+		// packed light volumes
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
+
+		// packed light intensities
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
+
+		// packed spot cones
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
+
+		// merged lights of BVH nodes
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, compositionStages);
+
+		// reduced resolution diffuse lighting and its normals
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, compositionStages);
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eCombinedImageSampler, 1, compositionStages);
 
 		vk::DescriptorSetLayoutCreateInfo createInfo;
 		createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -505,6 +1023,80 @@ void Renderer::createDescriptorSetLayouts()
 		mResource.descriptorSetLayout.add("composition", createInfo);
 	}
 
+	// Z-binning
+	{
+		std::vector<vk::DescriptorSetLayoutBinding> bindings;
+		// bins
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment);
+		// tile masks
+		bindings.emplace_back(static_cast<uint32_t>(bindings.size()), vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment);
+
+		vk::DescriptorSetLayoutCreateInfo createInfo;
+		createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		createInfo.pBindings = bindings.data();
+
+		mResource.descriptorSetLayout.add("zbin", createInfo);
+	}
+
+	// G-buffer input attachments of merged render pass
+	{
+		std::vector<vk::DescriptorSetLayoutBinding> bindings;
+		// position, albedo, normal, depth
+		for (uint32_t i = 0; i < 4; i++)
+			bindings.emplace_back(i, vk::DescriptorType::eInputAttachment, 1, vk::ShaderStageFlagBits::eFragment);
+
+		vk::DescriptorSetLayoutCreateInfo createInfo;
+		createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		createInfo.pBindings = bindings.data();
+
+		mResource.descriptorSetLayout.add("gbuffer_input", createInfo);
+	}
+
+	// triangle IDs of visibility buffer, input attachment of resolve subpass
+	{
+		vk::DescriptorSetLayoutBinding visibilityBinding;
+		visibilityBinding.binding = 0;
+		visibilityBinding.descriptorType = vk::DescriptorType::eInputAttachment;
+		visibilityBinding.descriptorCount = 1;
+		visibilityBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+		vk::DescriptorSetLayoutCreateInfo createInfo;
+		createInfo.bindingCount = 1;
+		createInfo.pBindings = &visibilityBinding;
+
+		mResource.descriptorSetLayout.add("visibility", createInfo);
+	}
+
+	// Composed image, written by compute composition and read by present pass
+	{
+		vk::DescriptorSetLayoutBinding imageBinding;
+		imageBinding.binding = 0;
+		imageBinding.descriptorType = vk::DescriptorType::eStorageImage;
+		imageBinding.descriptorCount = 1;
+		imageBinding.stageFlags = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment;
+
+		vk::DescriptorSetLayoutCreateInfo createInfo;
+		createInfo.bindingCount = 1;
+		createInfo.pBindings = &imageBinding;
+
+		mResource.descriptorSetLayout.add("composed", createInfo);
+	}
+
+	// Scene color of dynamic resolution, sampled by upscale pass
+	{
+		vk::DescriptorSetLayoutBinding imageBinding;
+		imageBinding.binding = 0;
+		imageBinding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+		imageBinding.descriptorCount = 1;
+		imageBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+		vk::DescriptorSetLayoutCreateInfo createInfo;
+		createInfo.bindingCount = 1;
+		createInfo.pBindings = &imageBinding;
+
+		mResource.descriptorSetLayout.add("scene_color", createInfo);
+	}
+
 	// Debug 
 	{
 		vk::DescriptorSetLayoutBinding uboBinding;
@@ -553,6 +1145,13 @@ void Renderer::createGraphicsPipelines()
 	viewportInfo.scissorCount = 1;
 	viewportInfo.pScissors = &scissor;
 
+	// G-buffer and lighting cover render extent of dynamic resolution, set when recorded
+	std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+
+	vk::PipelineDynamicStateCreateInfo dynamicStateInfo;
+	dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicStateInfo.pDynamicStates = dynamicStates.data();
+
 	vk::PipelineRasterizationStateCreateInfo rasterizer;
 	rasterizer.depthClampEnable = VK_FALSE;
 	rasterizer.rasterizerDiscardEnable = VK_FALSE;
@@ -584,10 +1183,13 @@ void Renderer::createGraphicsPipelines()
 		// create specialization constants
 		std::vector<vk::SpecializationMapEntry> entries;
 		entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Tile Size
-		entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Y_slices
+		entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Depth slices
+		entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Reconstruct position
+		entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Scalarized light loop
+		entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Diffuse scale
 
-		float ySlices = std::log(1.0f + (2.f * std::tanf(glm::radians(45.f / 2.f))) / mTileCount.y); // todo FOV as parameter
-		std::vector<uint32_t> constantData = {mCurrentTileSize, *reinterpret_cast<uint32_t*>(&ySlices)}; 
+		bool scalarize = BaseApp::getInstance().getUI().mContext.scalarizedLightLoop && mFragmentSubgroupArithmetic;
+		std::vector<uint32_t> constantData = {mCurrentTileSize, mDepthSlices, mReconstructPosition, scalarize, mDiffuseScale}; 
 		
 		vk::SpecializationInfo specializationInfo;
 		specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
@@ -595,9 +1197,30 @@ void Renderer::createGraphicsPipelines()
 		specializationInfo.dataSize = constantData.size() * 4;
 		specializationInfo.pData = constantData.data();
 
+		// merged pass reads G-buffer from input attachments
+		bool merged = mCompositionMode == CompositionMode::subpass;
+		std::string defines = merged ? "#define SUBPASS_INPUT\n" : "";
+
+		// spot falloff costs nothing in point only scenes
+		if (BaseApp::getInstance().getUI().mContext.spotLightFraction > 0.0f)
+			defines += "#define SPOT_LIGHTS\n";
+
+		// light lists may reference merged lights of BVH nodes
+		if (BaseApp::getInstance().getUI().mContext.lightLod)
+			defines += "#define LIGHT_LOD\n";
+
+		// reduced resolution pass shades diffuse only, full resolution one adds specular to upsampled diffuse
+		std::string diffuseDefines = defines + "#define DIFFUSE_ONLY\n";
+		if (mDiffuseScale > 1)
+			defines += "#define UPSAMPLED_DIFFUSE\n";
+
+		// light count heatmap replaces shading
+		if (BaseApp::getInstance().getUI().getDebugIndex() == DebugStates::lightCount)
+			defines += "#define HEATMAP\n";
+
 		// shader stages
 		auto vertShader = mResource.shaderModule.add("data/composite.vert");
-		auto fragShader = mResource.shaderModule.add("data/composite.frag");
+		auto fragShader = mResource.shaderModule.add("data/composite.frag", defines);
 
 		vk::PipelineShaderStageCreateInfo vertexStageInfo;
 		vertexStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
@@ -628,6 +1251,9 @@ void Renderer::createGraphicsPipelines()
 			mResource.descriptorSetLayout.get("composition")
 		};
 
+		if (merged)
+			setLayouts.emplace_back(mResource.descriptorSetLayout.get("gbuffer_input"));
+
 		vk::PipelineLayoutCreateInfo layoutInfo;
 		layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
 		layoutInfo.pSetLayouts = setLayouts.data();
@@ -645,15 +1271,16 @@ void Renderer::createGraphicsPipelines()
 		pipelineInfo.pMultisampleState = &multisampling;
 		pipelineInfo.pDepthStencilState = &depthStencil;
 		pipelineInfo.pColorBlendState = &blendingInfo;
+		pipelineInfo.pDynamicState = &dynamicStateInfo;
 		pipelineInfo.layout = layout;
-		pipelineInfo.renderPass = *mCompositionRenderpass;
-		pipelineInfo.subpass = 0;
+		pipelineInfo.renderPass = merged ? *mMergedRenderpass : mDynamicResolution ? *mSceneRenderpass : *mCompositionRenderpass;
+		pipelineInfo.subpass = merged ? 1 : 0;
 		pipelineInfo.basePipelineHandle = nullptr; // not deriving from existing pipeline
 
 		mResource.pipeline.add("composition", *mPipelineCache, pipelineInfo);
 
 		// tiled composition
-		fragmentStageInfo.module = mResource.shaderModule.add("data/composite_tiled.frag");
+		fragmentStageInfo.module = mResource.shaderModule.add("data/composite_tiled.frag", defines);
 		shaderStages[1] = fragmentStageInfo;
 		
 		pipelineInfo.layout = mResource.pipelineLayout.add("composition_tiled", layoutInfo);
@@ -667,11 +1294,148 @@ void Renderer::createGraphicsPipelines()
 		layoutInfo.pPushConstantRanges = &pushConstantRange;
 		layoutInfo.pushConstantRangeCount = 1;
 		
-		fragmentStageInfo.module = mResource.shaderModule.add("data/composite_deferred.frag");
+		fragmentStageInfo.module = mResource.shaderModule.add("data/composite_deferred.frag", defines);
 		shaderStages[1] = fragmentStageInfo;
 		
 		pipelineInfo.layout = mResource.pipelineLayout.add("composition_deferred", layoutInfo);
 		mResource.pipeline.add("composition_deferred", *mPipelineCache, pipelineInfo);
+
+		// light volumes, back faces of instanced spheres behind G-buffer depth add their light over ambient of deferred composition
+		if (mLightVolumes)
+		{
+			vk::PipelineShaderStageCreateInfo volumeStages[] = { vertexStageInfo, fragmentStageInfo };
+			volumeStages[0].module = mResource.shaderModule.add("data/light_volume.vert");
+			volumeStages[1].module = mResource.shaderModule.add("data/light_volume.frag", defines);
+
+			vk::PipelineInputAssemblyStateCreateInfo volumeAssemblyInfo;
+			volumeAssemblyInfo.topology = vk::PrimitiveTopology::eTriangleList;
+			volumeAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+			// back faces stay visible with camera inside volume, clamped ones still light far geometry
+			vk::PipelineRasterizationStateCreateInfo volumeRasterizer = rasterizer;
+			volumeRasterizer.depthClampEnable = mContext.getEnabledFeatures().depthClamp;
+			volumeRasterizer.cullMode = vk::CullModeFlagBits::eFront;
+			volumeRasterizer.frontFace = vk::FrontFace::eCounterClockwise;
+
+			vk::PipelineDepthStencilStateCreateInfo volumeDepthStencil;
+			volumeDepthStencil.depthTestEnable = VK_TRUE;
+			volumeDepthStencil.depthWriteEnable = VK_FALSE;
+			volumeDepthStencil.depthCompareOp = mReversedDepth ? vk::CompareOp::eLessOrEqual : vk::CompareOp::eGreaterOrEqual;
+
+			vk::PipelineColorBlendAttachmentState additiveAttachment = colorblendAttachment;
+			additiveAttachment.blendEnable = VK_TRUE;
+			additiveAttachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+			additiveAttachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+			additiveAttachment.colorBlendOp = vk::BlendOp::eAdd;
+			additiveAttachment.srcAlphaBlendFactor = vk::BlendFactor::eZero;
+			additiveAttachment.dstAlphaBlendFactor = vk::BlendFactor::eOne;
+			additiveAttachment.alphaBlendOp = vk::BlendOp::eAdd;
+
+			vk::PipelineColorBlendStateCreateInfo volumeBlendingInfo;
+			volumeBlendingInfo.attachmentCount = 1;
+			volumeBlendingInfo.pAttachments = &additiveAttachment;
+
+			vk::PipelineLayoutCreateInfo volumeLayoutInfo;
+			volumeLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+			volumeLayoutInfo.pSetLayouts = setLayouts.data();
+
+			vk::GraphicsPipelineCreateInfo volumeInfo = pipelineInfo;
+			volumeInfo.pStages = volumeStages;
+			volumeInfo.pInputAssemblyState = &volumeAssemblyInfo;
+			volumeInfo.pRasterizationState = &volumeRasterizer;
+			volumeInfo.pDepthStencilState = &volumeDepthStencil;
+			volumeInfo.pColorBlendState = &volumeBlendingInfo;
+			volumeInfo.layout = mResource.pipelineLayout.add("light_volume", volumeLayoutInfo);
+
+			mResource.pipeline.add("light_volume", *mPipelineCache, volumeInfo);
+		}
+
+		// z-binning composition, G-buffer input set is bound in both modes to keep bin set index fixed
+		std::vector<vk::DescriptorSetLayout> zbinSetLayouts = {
+			mResource.descriptorSetLayout.get("camera"),
+			mResource.descriptorSetLayout.get("composition"),
+			mResource.descriptorSetLayout.get("gbuffer_input"),
+			mResource.descriptorSetLayout.get("zbin")
+		};
+
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(zbinSetLayouts.size());
+		layoutInfo.pSetLayouts = zbinSetLayouts.data();
+
+		fragmentStageInfo.module = mResource.shaderModule.add("data/composite_zbin.frag", defines);
+		shaderStages[1] = fragmentStageInfo;
+
+		pipelineInfo.layout = mResource.pipelineLayout.add("composition_zbin", layoutInfo);
+		mResource.pipeline.add("composition_zbin", *mPipelineCache, pipelineInfo);
+
+		// reduced resolution diffuse passes, share layouts of their full resolution composition
+		if (mDiffuseScale > 1)
+		{
+			std::array<vk::PipelineColorBlendAttachmentState, 2> diffuseAttachments = { colorblendAttachment, colorblendAttachment };
+
+			vk::PipelineColorBlendStateCreateInfo diffuseBlendingInfo;
+			diffuseBlendingInfo.attachmentCount = static_cast<uint32_t>(diffuseAttachments.size());
+			diffuseBlendingInfo.pAttachments = diffuseAttachments.data();
+
+			vk::GraphicsPipelineCreateInfo diffuseInfo = pipelineInfo;
+			diffuseInfo.pColorBlendState = &diffuseBlendingInfo;
+			diffuseInfo.renderPass = *mDiffuseRenderpass;
+			diffuseInfo.subpass = 0;
+
+			std::pair<const char*, const char*> compositions[] = {
+				{ "composition", "data/composite.frag" },
+				{ "composition_tiled", "data/composite_tiled.frag" },
+				{ "composition_deferred", "data/composite_deferred.frag" },
+				{ "composition_zbin", "data/composite_zbin.frag" }
+			};
+
+			for (const auto& [name, file] : compositions)
+			{
+				fragmentStageInfo.module = mResource.shaderModule.add(file, diffuseDefines);
+				shaderStages[1] = fragmentStageInfo;
+
+				diffuseInfo.layout = mResource.pipelineLayout.get(name);
+				mResource.pipeline.add(std::string(name) + "_diffuse", *mPipelineCache, diffuseInfo);
+			}
+		}
+
+		// present of compute composition output
+		if (mCompositionMode == CompositionMode::compute)
+		{
+			fragmentStageInfo.module = mResource.shaderModule.add("data/present.frag");
+			fragmentStageInfo.pSpecializationInfo = nullptr;
+			shaderStages[1] = fragmentStageInfo;
+
+			vk::PipelineLayoutCreateInfo presentLayoutInfo;
+			presentLayoutInfo.setLayoutCount = 1;
+			presentLayoutInfo.pSetLayouts = &mResource.descriptorSetLayout.get("composed");
+
+			pipelineInfo.layout = mResource.pipelineLayout.add("present", presentLayoutInfo);
+			pipelineInfo.pDynamicState = nullptr; // swapchain extent
+			mResource.pipeline.add("present", *mPipelineCache, pipelineInfo);
+		}
+
+		// upscale of dynamic resolution scene color to swapchain, followed by UI subpass
+		if (mDynamicResolution)
+		{
+			fragmentStageInfo.module = mResource.shaderModule.add("data/upscale.frag");
+			fragmentStageInfo.pSpecializationInfo = nullptr;
+			shaderStages[1] = fragmentStageInfo;
+
+			vk::PushConstantRange upscaleRange;
+			upscaleRange.stageFlags = vk::ShaderStageFlagBits::eFragment;
+			upscaleRange.size = sizeof(glm::vec2);
+
+			vk::PipelineLayoutCreateInfo upscaleLayoutInfo;
+			upscaleLayoutInfo.setLayoutCount = 1;
+			upscaleLayoutInfo.pSetLayouts = &mResource.descriptorSetLayout.get("scene_color");
+			upscaleLayoutInfo.pushConstantRangeCount = 1;
+			upscaleLayoutInfo.pPushConstantRanges = &upscaleRange;
+
+			pipelineInfo.layout = mResource.pipelineLayout.add("upscale", upscaleLayoutInfo);
+			pipelineInfo.pDynamicState = nullptr; // swapchain extent
+			pipelineInfo.renderPass = *mCompositionRenderpass;
+			mResource.pipeline.add("upscale", *mPipelineCache, pipelineInfo);
+		}
 	}
 
 	// debug pipeline
@@ -680,6 +1444,16 @@ void Renderer::createGraphicsPipelines()
 		inputAssemblyInfo.topology = vk::PrimitiveTopology::eTriangleStrip;
 		inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
 
+		// reconstruct position constant, id matches composition shaders
+		vk::SpecializationMapEntry entry(2, 0, 4);
+		VkBool32 reconstructPosition = mReconstructPosition;
+
+		vk::SpecializationInfo specializationInfo;
+		specializationInfo.mapEntryCount = 1;
+		specializationInfo.pMapEntries = &entry;
+		specializationInfo.dataSize = sizeof(reconstructPosition);
+		specializationInfo.pData = &reconstructPosition;
+
 		// shader stages
 		auto vertShader = mResource.shaderModule.add("data/debug.vert");
 		auto fragShader = mResource.shaderModule.add("data/debug.frag");
@@ -693,6 +1467,7 @@ void Renderer::createGraphicsPipelines()
 		fragmentStageInfo.stage = vk::ShaderStageFlagBits::eFragment;
 		fragmentStageInfo.module = fragShader;
 		fragmentStageInfo.pName = "main";
+		fragmentStageInfo.pSpecializationInfo = &specializationInfo;
 
 		vk::PipelineShaderStageCreateInfo shaderStages[] = { vertexStageInfo, fragmentStageInfo };
 
@@ -710,6 +1485,7 @@ void Renderer::createGraphicsPipelines()
 		std::vector<vk::DescriptorSetLayout> setLayouts = {
 			mResource.descriptorSetLayout.get("debug"),
 			mResource.descriptorSetLayout.get("composition"),
+			mResource.descriptorSetLayout.get("camera")
 		};
 
 		vk::PipelineLayoutCreateInfo layoutInfo;
@@ -740,8 +1516,10 @@ void Renderer::createGraphicsPipelines()
 
 	// create G buffer construction pipeline
 	{
+		const std::string materialDefines = "#define MAX_MATERIAL_TEXTURES " + std::to_string(getMaterialTextureCount(mContext.getPhysicalDevice())) + "\n";
+
 		auto vertShader = mResource.shaderModule.add("data/gbuffers.vert");
-		auto fragShader = mResource.shaderModule.add("data/gbuffers.frag");
+		auto fragShader = mResource.shaderModule.add("data/gbuffers.frag", materialDefines);
 
 		vk::PipelineShaderStageCreateInfo vertexStageInfo;
 		vertexStageInfo.stage = vk::ShaderStageFlagBits::eVertex;
@@ -769,7 +1547,7 @@ void Renderer::createGraphicsPipelines()
 		vk::PipelineDepthStencilStateCreateInfo depthStencil;
 		depthStencil.depthTestEnable = VK_TRUE;
 		depthStencil.depthWriteEnable = VK_TRUE;
-		depthStencil.depthCompareOp = vk::CompareOp::eLess;
+		depthStencil.depthCompareOp = mReversedDepth ? vk::CompareOp::eGreater : vk::CompareOp::eLess;
 		depthStencil.depthBoundsTestEnable = VK_FALSE;
 		depthStencil.stencilTestEnable = VK_FALSE;
 
@@ -787,9 +1565,16 @@ void Renderer::createGraphicsPipelines()
 			mResource.descriptorSetLayout.get("material")
 		};
 
+		// triangle ID split and index section offset of visibility buffer
+		vk::PushConstantRange pushConstantRange;
+		pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eFragment;
+		pushConstantRange.size = 2 * sizeof(uint32_t);
+
 		vk::PipelineLayoutCreateInfo layoutInfo;
 		layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
 		layoutInfo.pSetLayouts = setLayouts.data();
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
 
 		auto layout = mResource.pipelineLayout.add("gbuffers", layoutInfo);
 
@@ -804,19 +1589,185 @@ void Renderer::createGraphicsPipelines()
 		pipelineInfo.pMultisampleState = &multisampling;
 		pipelineInfo.pDepthStencilState = &depthStencil;
 		pipelineInfo.pColorBlendState = &blendingInfo;
+		pipelineInfo.pDynamicState = &dynamicStateInfo;
 		pipelineInfo.layout = layout;
 		pipelineInfo.renderPass = *mGBufferRenderpass;
-		pipelineInfo.subpass = 0;
+		pipelineInfo.subpass = mVisibilityBuffer ? 1 : 0; // unused with visibility buffer, kept compatible with its G-buffer subpass
 		pipelineInfo.basePipelineHandle = mResource.pipeline.get("composition"); // derive from composition pipeline
 		pipelineInfo.basePipelineIndex = -1;
 
+		// G-buffer only shades fragments visible in depth prepass, merged pass always has one
+		if (mCompositionMode == CompositionMode::subpass || mDepthPrepass)
+		{
+			depthStencil.depthWriteEnable = VK_FALSE;
+			depthStencil.depthCompareOp = vk::CompareOp::eEqual;
+		}
+
+		if (mCompositionMode == CompositionMode::subpass)
+			pipelineInfo.renderPass = *mMergedRenderpass;
+
 		mResource.pipeline.add("gbuffers", *mPipelineCache, pipelineInfo);
+
+		// packed vertex variant
+		auto packedBindingDescription = util::getPackedVertexBindingDescription();
+		auto packedAttrDescription = util::getPackedVertexAttributeDescriptions();
+
+		vertexInputInfo.pVertexBindingDescriptions = &packedBindingDescription;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(packedAttrDescription.size());
+		vertexInputInfo.pVertexAttributeDescriptions = packedAttrDescription.data();
+
+		vertexStageInfo.module = mResource.shaderModule.add("data/gbuffers_packed.vert");
+		shaderStages[0] = vertexStageInfo;
+
+		mResource.pipeline.add("gbuffers_packed", *mPipelineCache, pipelineInfo);
+
+		// visibility buffer, same vertex shaders rasterize triangle IDs only
+		if (mVisibilityBuffer)
+		{
+			vk::PipelineShaderStageCreateInfo visibilityStages[] = { vertexStageInfo, fragmentStageInfo };
+			visibilityStages[1].module = mResource.shaderModule.add("data/visibility.frag");
+
+			vk::PipelineColorBlendStateCreateInfo visibilityBlendingInfo;
+			visibilityBlendingInfo.attachmentCount = 1;
+			visibilityBlendingInfo.pAttachments = blendAttachments.data();
+
+			vk::GraphicsPipelineCreateInfo visibilityInfo = pipelineInfo;
+			visibilityInfo.subpass = 0;
+			visibilityInfo.pStages = visibilityStages;
+			visibilityInfo.pColorBlendState = &visibilityBlendingInfo;
+
+			mResource.pipeline.add("visibility_packed", *mPipelineCache, visibilityInfo);
+
+			vk::PipelineVertexInputStateCreateInfo unpackedInputInfo = vertexInputInfo;
+			unpackedInputInfo.pVertexBindingDescriptions = &bindingDescription;
+			unpackedInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attrDescription.size());
+			unpackedInputInfo.pVertexAttributeDescriptions = attrDescription.data();
+
+			visibilityStages[0].module = vertShader;
+			visibilityInfo.pVertexInputState = &unpackedInputInfo;
+
+			mResource.pipeline.add("visibility", *mPipelineCache, visibilityInfo);
+
+			// resolve, full screen pass fetches attributes and materials of visible triangles
+			vk::PipelineInputAssemblyStateCreateInfo resolveAssemblyInfo;
+			resolveAssemblyInfo.topology = vk::PrimitiveTopology::eTriangleStrip;
+			resolveAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+			vk::PipelineVertexInputStateCreateInfo resolveInputInfo; // empty - positions will be created in VS
+
+			vk::PipelineRasterizationStateCreateInfo resolveRasterizer = rasterizer;
+			resolveRasterizer.cullMode = vk::CullModeFlagBits::eNone;
+
+			vk::PipelineDepthStencilStateCreateInfo resolveDepthStencil;
+
+			std::vector<vk::DescriptorSetLayout> resolveSetLayouts = setLayouts;
+			resolveSetLayouts.emplace_back(mResource.descriptorSetLayout.get("visibility"));
+
+			vk::PipelineLayoutCreateInfo resolveLayoutInfo = layoutInfo;
+			resolveLayoutInfo.setLayoutCount = static_cast<uint32_t>(resolveSetLayouts.size());
+			resolveLayoutInfo.pSetLayouts = resolveSetLayouts.data();
+
+			vk::PipelineShaderStageCreateInfo resolveStages[] = { vertexStageInfo, fragmentStageInfo };
+			resolveStages[0].module = mResource.shaderModule.add("data/composite.vert");
+			resolveStages[1].module = mResource.shaderModule.add("data/visibility_resolve.frag", materialDefines);
+
+			vk::GraphicsPipelineCreateInfo resolveInfo = pipelineInfo;
+			resolveInfo.pStages = resolveStages;
+			resolveInfo.pVertexInputState = &resolveInputInfo;
+			resolveInfo.pInputAssemblyState = &resolveAssemblyInfo;
+			resolveInfo.pRasterizationState = &resolveRasterizer;
+			resolveInfo.pDepthStencilState = &resolveDepthStencil;
+			resolveInfo.layout = mResource.pipelineLayout.add("visibility_resolve", resolveLayoutInfo);
+			resolveInfo.subpass = 1;
+
+			mResource.pipeline.add("visibility_resolve", *mPipelineCache, resolveInfo);
+
+			resolveStages[1].module = mResource.shaderModule.add("data/visibility_resolve.frag", materialDefines + "#define PACKED_VERTICES\n");
+			mResource.pipeline.add("visibility_resolve_packed", *mPipelineCache, resolveInfo);
+		}
+
+		// depth prepass, vertex shader only reading position stream
+		if (mCompositionMode == CompositionMode::subpass || mDepthPrepass)
+		{
+			depthStencil.depthWriteEnable = VK_TRUE;
+			depthStencil.depthCompareOp = mReversedDepth ? vk::CompareOp::eGreater : vk::CompareOp::eLess;
+			blendingInfo.attachmentCount = 0;
+
+			auto positionBinding = util::getPositionBindingDescription(true);
+			auto positionAttribute = util::getPositionAttributeDescription(true);
+
+			vertexInputInfo.pVertexBindingDescriptions = &positionBinding;
+			vertexInputInfo.vertexAttributeDescriptionCount = 1;
+			vertexInputInfo.pVertexAttributeDescriptions = &positionAttribute;
+
+			vertexStageInfo.module = mResource.shaderModule.add("data/depth_prepass.vert", "#define PACKED_VERTICES\n");
+			shaderStages[0] = vertexStageInfo;
+
+			pipelineInfo.stageCount = 1;
+			pipelineInfo.renderPass = *mDepthPrepassRenderpass;
+			pipelineInfo.subpass = 0;
+
+			mResource.pipeline.add("depth_prepass_packed", *mPipelineCache, pipelineInfo);
+
+			positionBinding = util::getPositionBindingDescription(false);
+			positionAttribute = util::getPositionAttributeDescription(false);
+
+			vertexStageInfo.module = mResource.shaderModule.add("data/depth_prepass.vert");
+			shaderStages[0] = vertexStageInfo;
+
+			mResource.pipeline.add("depth_prepass", *mPipelineCache, pipelineInfo);
+		}
 	}
 }
 
 void Renderer::createGBuffers()
 {
 	mGBufferAttachments = generateGBuffer();
+
+	// output of compute composition, stays in general layout
+	mComposedImage = {};
+	if (mCompositionMode == CompositionMode::compute)
+	{
+		mComposedImage = mUtility.createImage(
+			mSwapchainExtent.width, mSwapchainExtent.height,
+			vk::Format::eR16G16B16A16Sfloat,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eStorage,
+			vk::MemoryPropertyFlagBits::eDeviceLocal
+		);
+
+		mComposedImage.view = mUtility.createImageView(*mComposedImage.handle, mComposedImage.format, vk::ImageAspectFlagBits::eColor);
+	}
+
+	// reduced resolution diffuse lighting, upsampled by composition
+	mDiffuseImage = {};
+	mDiffuseNormal = {};
+	if (mDiffuseScale > 1)
+	{
+		auto extent = getDiffuseExtent(mSwapchainExtent);
+		auto usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
+
+		mDiffuseImage = mUtility.createImage(extent.width, extent.height, vk::Format::eR16G16B16A16Sfloat, vk::ImageTiling::eOptimal, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		mDiffuseImage.view = mUtility.createImageView(*mDiffuseImage.handle, mDiffuseImage.format, vk::ImageAspectFlagBits::eColor);
+
+		mDiffuseNormal = mUtility.createImage(extent.width, extent.height, vk::Format::eR16G16Sfloat, vk::ImageTiling::eOptimal, usage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		mDiffuseNormal.view = mUtility.createImageView(*mDiffuseNormal.handle, mDiffuseNormal.format, vk::ImageAspectFlagBits::eColor);
+	}
+
+	// scene color of dynamic resolution, full size so scale changes need no reallocation
+	mSceneColor = {};
+	if (mDynamicResolution)
+	{
+		mSceneColor = mUtility.createImage(
+			mSwapchainExtent.width, mSwapchainExtent.height,
+			vk::Format::eR16G16B16A16Sfloat,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+			vk::MemoryPropertyFlagBits::eDeviceLocal
+		);
+
+		mSceneColor.view = mUtility.createImageView(*mSceneColor.handle, mSceneColor.format, vk::ImageAspectFlagBits::eColor);
+	}
 }
 
 void Renderer::createSampler()
@@ -871,6 +1822,33 @@ void Renderer::createUniformBuffers()
 		);
 	}
 
+	// tiled light references, overflow and longest list readback
+	{
+		mTiledStatsBuffer = mUtility.createBuffer(
+			3 * sizeof(uint32_t),
+			vk::BufferUsageFlagBits::eTransferDst,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		);
+	}
+
+	// unique clusters, their light references, depth bounds, longest list and allocated pages readback
+	{
+		mClusterStatsBuffer = mUtility.createBuffer(
+			6 * sizeof(uint32_t),
+			vk::BufferUsageFlagBits::eTransferDst,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		);
+	}
+
+	// z-bin tile light references readback
+	{
+		mZBinStatsBuffer = mUtility.createBuffer(
+			sizeof(uint32_t),
+			vk::BufferUsageFlagBits::eTransferDst,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+		);
+	}
+
 	// debug
 	{
 		mDebugUniformBuffer = mUtility.createBuffer(
@@ -889,29 +1867,74 @@ void Renderer::createClusteredBuffers()
 		return ((size - 1) / align + 1) * align;
 	};
 	
-	// page table
+	// page table covers whole virtual key space, see setTileCount
 	mPageTableOffset = 0;
-	mPageTableSize = alignedMemorySize((2'048 + 3) * sizeof(uint32_t)); 
+	mPageTableSize = alignedMemorySize((mPageTableEntries + 3) * sizeof(uint32_t)); 
 
-	// physical page pool
-	constexpr vk::DeviceSize pageCount = 512; // requires manual tweaking
-	constexpr vk::DeviceSize pageSize = 4'096 * sizeof(uint32_t);
+	// physical page pool, quarter of virtual pages
+	mPagePoolPages = std::max(mPageTableEntries / 4, 1u);
+	const vk::DeviceSize pageSize = (vk::DeviceSize(1) << mPageSizePower) * sizeof(uint32_t);
 	
 	mPagePoolOffset = mPageTableSize;
-	mPagePoolSize = alignedMemorySize(pageCount * pageSize);
+	mPagePoolSize = alignedMemorySize(mPagePoolPages * pageSize);
 
-	// compacted unique clusters 
-	// default value is 32k of unique clusters, every scene should tweak this value
-	// rule of thumb is, the less depth discontiunities, the less unique clusters will be created
+	// compacted unique clusters, every cluster of screen at most, but no more than page pool holds
+	vk::DeviceSize maxClusters = std::min(vk::DeviceSize(mTileCount.x) * mTileCount.y * mDepthSlices, vk::DeviceSize(mPagePoolPages) << mPageSizePower);
 	mUniqueClustersOffset = mPagePoolOffset + mPagePoolSize;
-	mUniqueClustersSize = alignedMemorySize(32'768 * sizeof(uint32_t));
+	mUniqueClustersSize = alignedMemorySize((maxClusters + 5) * sizeof(uint32_t)); // header of counter and indirect dispatch, counter starts at one
+
+	// light references counter, depth bounds and longest light list of culling statistics
+	mClusterStatsOffset = mUniqueClustersOffset + mUniqueClustersSize;
+	mClusterStatsSize = alignedMemorySize(4 * sizeof(uint32_t));
 
 	// allocate buffer
 	mClusteredBuffer = mUtility.createBuffer(
-		mPageTableSize + mPagePoolSize + mUniqueClustersSize,
-		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndirectBuffer,
+		mPageTableSize + mPagePoolSize + mUniqueClustersSize + mClusterStatsSize,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eIndirectBuffer,
+		vk::MemoryPropertyFlagBits::eDeviceLocal
+	);
+}
+
+void Renderer::updateZBinBuffer()
+{
+	// tile masks take bit per light and tile, sorted lights beyond buffer range are dropped, they are the farthest ones
+	const auto limits = mContext.getPhysicalDevice().getProperties().limits;
+	const uint32_t tileCount = mTileCount.x * mTileCount.y;
+	const vk::DeviceSize maxWordsPerTile = std::min<vk::DeviceSize>(limits.maxStorageBufferRange, MAX_ZBIN_MASK_SIZE) / sizeof(uint32_t) / tileCount;
+	mZBinWordsPerTile = static_cast<uint32_t>(std::min<vk::DeviceSize>((mLightsCount - 1) / 32 + 1, maxWordsPerTile));
+	mZBinLightCount = std::min(mLightsCount, mZBinWordsPerTile * 32);
+
+	vk::DeviceSize maskSize = vk::DeviceSize(tileCount) * mZBinWordsPerTile * sizeof(uint32_t);
+	if (mZBinBuffer.handle && maskSize == mZBinMaskSize)
+		return;
+
+	// z-bins, min and max sorted light index for each of 1024 bins and light references counter, followed by tile masks
+	const auto align = limits.minStorageBufferOffsetAlignment;
+	mZBinMaskOffset = (((2 * 1'024 + 1) * sizeof(uint32_t) - 1) / align + 1) * align;
+	mZBinMaskSize = maskSize;
+
+	mContext.getGeneralQueue().waitIdle(); // previous frames read old masks
+	mZBinBuffer = mUtility.createBuffer(
+		mZBinMaskOffset + mZBinMaskSize,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc,
 		vk::MemoryPropertyFlagBits::eDeviceLocal
 	);
+
+	writeZBinDescriptorSet();
+}
+
+void Renderer::writeZBinDescriptorSet()
+{
+	auto targetSet = mResource.descriptorSet.get("zbin");
+	vk::DescriptorBufferInfo binsInfo{ *mZBinBuffer.handle, 0, mZBinMaskOffset };
+	vk::DescriptorBufferInfo masksInfo{ *mZBinBuffer.handle, mZBinMaskOffset, mZBinMaskSize };
+
+	std::array<vk::WriteDescriptorSet, 2> writes = {
+		util::createDescriptorWriteBuffer(targetSet, 0, vk::DescriptorType::eStorageBuffer, binsInfo),
+		util::createDescriptorWriteBuffer(targetSet, 1, vk::DescriptorType::eStorageBuffer, masksInfo)
+	};
+
+	mContext.getDevice().updateDescriptorSets(writes, nullptr);
 }
 
 void Renderer::createLights()
@@ -919,12 +1942,20 @@ void Renderer::createLights()
 	mPointLightsSize = sizeof(PointLight) * MAX_LIGHTS;
 	mLightsOutSwap = MAX_LIGHTS * 20 * 4; // every sceene need to tweak this value
 	mLightsOutSize = mLightsOutSwap;
+	mPackedLightsSize = 2 * sizeof(uint32_t) * MAX_LIGHTS; // volumes for culling, intensities and spot cones for shading, written by sorting
 
 	mLightsOutOffset = 0;
 	mPointLightsOffset = mLightsOutSize;
 	mLightsOutSwapOffset = mPointLightsOffset + mPointLightsSize;
+	mLightVolumesOffset = mLightsOutSwapOffset + mLightsOutSwap;
+	mLightIntensitiesOffset = mLightVolumesOffset + mPackedLightsSize;
+	mLightSpotsOffset = mLightIntensitiesOffset + mPackedLightsSize;
 
-	vk::DeviceSize bufferSize = mPointLightsSize + mLightsOutSize + mLightsOutSwap;
+	// merged lights of BVH nodes for light LOD, stored after spot cones
+	mNodeLightsSize = 3 * sizeof(glm::vec4) * (MAX_LIGHTS / 2);
+	mNodeLightsOffset = mLightSpotsOffset + mPackedLightsSize;
+
+	vk::DeviceSize bufferSize = mPointLightsSize + mLightsOutSize + mLightsOutSwap + 3 * mPackedLightsSize + mNodeLightsSize;
 
 	// allocate buffer
 	mPointLightsStagingBuffer = mUtility.createBuffer(
@@ -958,13 +1989,17 @@ void Renderer::createLights()
 void Renderer::createDescriptorPool()
 {
 	// Create descriptor pool for uniform buffer
-	std::array<vk::DescriptorPoolSize, 3> poolSizes;
+	std::array<vk::DescriptorPoolSize, 5> poolSizes;
 	poolSizes[0].type = vk::DescriptorType::eUniformBuffer;
 	poolSizes[0].descriptorCount = 100; 
 	poolSizes[1].type = vk::DescriptorType::eCombinedImageSampler;
-	poolSizes[1].descriptorCount = 100; 
+	poolSizes[1].descriptorCount = 2 * getMaterialTextureCount(mContext.getPhysicalDevice()) + 100; // material texture array is reallocated on scene change
 	poolSizes[2].type = vk::DescriptorType::eStorageBuffer;
 	poolSizes[2].descriptorCount = 100;
+	poolSizes[3].type = vk::DescriptorType::eInputAttachment;
+	poolSizes[3].descriptorCount = 10;
+	poolSizes[4].type = vk::DescriptorType::eStorageImage;
+	poolSizes[4].descriptorCount = 10;
 
 	vk::DescriptorPoolCreateInfo poolInfo;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
@@ -991,6 +2026,25 @@ void Renderer::createDescriptorSets()
 	mResource.descriptorSet.add("composition_front", allocInfo);
 	mResource.descriptorSet.add("composition_back", allocInfo);
 
+	// merged pass G-buffer
+	allocInfo.pSetLayouts = &mResource.descriptorSetLayout.get("gbuffer_input");
+	mResource.descriptorSet.add("gbuffer_input", allocInfo);
+
+	// compute composition output
+	allocInfo.pSetLayouts = &mResource.descriptorSetLayout.get("composed");
+	mResource.descriptorSet.add("composed", allocInfo);
+
+	// dynamic resolution scene color
+	allocInfo.pSetLayouts = &mResource.descriptorSetLayout.get("scene_color");
+	mResource.descriptorSet.add("scene_color", allocInfo);
+
+	allocInfo.pSetLayouts = &mResource.descriptorSetLayout.get("visibility");
+	mResource.descriptorSet.add("visibility", allocInfo);
+
+	// z-binning
+	allocInfo.pSetLayouts = &mResource.descriptorSetLayout.get("zbin");
+	mResource.descriptorSet.add("zbin", allocInfo);
+
 	// world transform
 	allocInfo.pSetLayouts = &mResource.descriptorSetLayout.get("camera");
 	mResource.descriptorSet.add("camera", allocInfo);
@@ -1048,12 +2102,42 @@ void Renderer::updateDescriptorSets()
 	vk::DescriptorBufferInfo pageTableInfo{ *mClusteredBuffer.handle, mPageTableOffset, mPageTableSize };
 	vk::DescriptorBufferInfo pagePoolInfo{ *mClusteredBuffer.handle, mPagePoolOffset, mPagePoolSize };
 	vk::DescriptorBufferInfo uniqueClustersInfo{ *mClusteredBuffer.handle, mUniqueClustersOffset, mUniqueClustersSize };
+	vk::DescriptorBufferInfo clusterStatsInfo{ *mClusteredBuffer.handle, mClusterStatsOffset, mClusterStatsSize };
+	vk::DescriptorBufferInfo lightVolumesInfo{ *mLightsBuffers.handle, mLightVolumesOffset, mPackedLightsSize };
+	vk::DescriptorBufferInfo lightIntensitiesInfo{ *mLightsBuffers.handle, mLightIntensitiesOffset, mPackedLightsSize };
+	vk::DescriptorBufferInfo lightSpotsInfo{ *mLightsBuffers.handle, mLightSpotsOffset, mPackedLightsSize };
+	vk::DescriptorBufferInfo nodeLightsInfo{ *mLightsBuffers.handle, mNodeLightsOffset, mNodeLightsSize };
 	
-	vk::DescriptorImageInfo depthInfo{ *mSampler, *mGBufferAttachments.depth.view, vk::ImageLayout::eShaderReadOnlyOptimal };
-	vk::DescriptorImageInfo positionInfo{ *mSampler, *mGBufferAttachments.position.view, vk::ImageLayout::eShaderReadOnlyOptimal };
+	vk::DescriptorImageInfo depthInfo{ *mSampler, *mGBufferAttachments.depth.view, getSampledDepthLayout() };
+	vk::DescriptorImageInfo positionInfo{ *mSampler, mReconstructPosition ? *mGBufferAttachments.color.view : *mGBufferAttachments.position.view, vk::ImageLayout::eShaderReadOnlyOptimal }; // placeholder when unused
 	vk::DescriptorImageInfo albedoInfo{ *mSampler, *mGBufferAttachments.color.view, vk::ImageLayout::eShaderReadOnlyOptimal };
 	vk::DescriptorImageInfo normalInfo{ *mSampler, *mGBufferAttachments.normal.view, vk::ImageLayout::eShaderReadOnlyOptimal };
 
+	// merged pass reads G-buffer as input attachments
+	std::array<vk::DescriptorImageInfo, 4> inputInfos = { positionInfo, albedoInfo, normalInfo, depthInfo };
+	for (auto& info : inputInfos)
+		info.sampler = nullptr;
+
+	inputInfos.back().imageLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+
+	// composition samples depth while it is attached read only for light volume depth test
+	vk::DescriptorImageInfo compositionDepthInfo = depthInfo;
+	if (mLightVolumes)
+		compositionDepthInfo.imageLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+
+	// transient G-buffer of merged pass cannot be sampled, sampled bindings get depth as placeholder
+	if (mCompositionMode == CompositionMode::subpass)
+		positionInfo.imageView = albedoInfo.imageView = normalInfo.imageView = *mGBufferAttachments.depth.view;
+
+	// diffuse targets exist only with reduced diffuse resolution
+	vk::DescriptorImageInfo diffuseInfo = albedoInfo;
+	vk::DescriptorImageInfo diffuseNormalInfo = albedoInfo;
+	if (mDiffuseScale > 1)
+	{
+		diffuseInfo.imageView = *mDiffuseImage.view;
+		diffuseNormalInfo.imageView = *mDiffuseNormal.view;
+	}
+
 	std::vector<vk::WriteDescriptorSet> descriptorWrites;
 
 	// Light culling
@@ -1069,6 +2153,11 @@ void Renderer::updateDescriptorSets()
 		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, pageTableInfo));
 		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, pagePoolInfo));
 		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, uniqueClustersInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, clusterStatsInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, lightVolumesInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, lightIntensitiesInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, lightSpotsInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, nodeLightsInfo));
 
 		descriptorWrites.insert(descriptorWrites.end(), writes.begin(), writes.end());
 
@@ -1094,10 +2183,16 @@ void Renderer::updateDescriptorSets()
 		writes.emplace_back(util::createDescriptorWriteImage(targetSet, binding++, positionInfo));
 		writes.emplace_back(util::createDescriptorWriteImage(targetSet, binding++, albedoInfo));
 		writes.emplace_back(util::createDescriptorWriteImage(targetSet, binding++, normalInfo));
-		writes.emplace_back(util::createDescriptorWriteImage(targetSet, binding++, depthInfo));
+		writes.emplace_back(util::createDescriptorWriteImage(targetSet, binding++, compositionDepthInfo));
 		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, pageTableInfo));
 		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, pagePoolInfo));
 		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, uniqueClustersInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, lightVolumesInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, lightIntensitiesInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, lightSpotsInfo));
+		writes.emplace_back(util::createDescriptorWriteBuffer(targetSet, binding++, vk::DescriptorType::eStorageBuffer, nodeLightsInfo));
+		writes.emplace_back(util::createDescriptorWriteImage(targetSet, binding++, diffuseInfo));
+		writes.emplace_back(util::createDescriptorWriteImage(targetSet, binding++, diffuseNormalInfo));
 		
 		descriptorWrites.insert(descriptorWrites.end(), writes.begin(), writes.end());
 		
@@ -1110,12 +2205,49 @@ void Renderer::updateDescriptorSets()
 	
 		descriptorWrites.insert(descriptorWrites.end(), writes.begin(), writes.end());
 	}
+
+	// G-buffer input attachments
+	{
+		auto targetSet = mResource.descriptorSet.get("gbuffer_input");
+
+		for (uint32_t i = 0; i < inputInfos.size(); i++)
+			descriptorWrites.emplace_back(util::createDescriptorWriteImage(targetSet, i, inputInfos[i], vk::DescriptorType::eInputAttachment));
+	}
+
+	// z-binning, masks are allocated only while it is selected
+	if (mZBinBuffer.handle)
+		writeZBinDescriptorSet();
+
+	// composed image exists only in compute composition mode
+	vk::DescriptorImageInfo composedInfo{ nullptr, *mComposedImage.view, vk::ImageLayout::eGeneral };
+	if (mComposedImage.view)
+		descriptorWrites.emplace_back(util::createDescriptorWriteImage(mResource.descriptorSet.get("composed"), 0, composedInfo, vk::DescriptorType::eStorageImage));
+
+	// scene color exists only with dynamic resolution
+	vk::DescriptorImageInfo sceneColorInfo{ *mSampler, *mSceneColor.view, vk::ImageLayout::eShaderReadOnlyOptimal };
+	if (mSceneColor.view)
+		descriptorWrites.emplace_back(util::createDescriptorWriteImage(mResource.descriptorSet.get("scene_color"), 0, sceneColorInfo));
+
+	// triangle IDs exist only in visibility buffer mode
+	vk::DescriptorImageInfo visibilityInfo{ nullptr, *mGBufferAttachments.visibility.view, vk::ImageLayout::eShaderReadOnlyOptimal };
+	if (mGBufferAttachments.visibility.view)
+		descriptorWrites.emplace_back(util::createDescriptorWriteImage(mResource.descriptorSet.get("visibility"), 0, visibilityInfo, vk::DescriptorType::eInputAttachment));
 		
 	mContext.getDevice().updateDescriptorSets(descriptorWrites, nullptr);
 }
 
 void Renderer::createGraphicsCommandBuffers()
 {
+	// GPU frame begins with first G-buffer submission, dynamic resolution holds it to target
+	auto writeFrameTimestamp = [this](vk::CommandBuffer cmd)
+	{
+		if (!mTimestampQueryPool)
+			return;
+
+		cmd.resetQueryPool(*mTimestampQueryPool, 3, 1);
+		cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *mTimestampQueryPool, 3);
+	};
+
 	// allocate buffers
 	{
 		vk::CommandBufferAllocateInfo allocInfo;
@@ -1138,67 +2270,137 @@ void Renderer::createGraphicsCommandBuffers()
 		allocInfo.commandBufferCount = 1;
 
 		mResource.cmd.add("gBuffer", allocInfo);
+		mResource.cmd.add("depthPrepass", allocInfo);
 	}
 
-	// Gbuffers
+	// Gbuffers, depth only when G-buffer is merged with composition
 	{
 		vk::CommandBufferBeginInfo beginInfo;
 		beginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
 
-		std::array<vk::ClearValue, 4> clearValues;
-		clearValues[0].color.setFloat32({ 0.0f, 0.0f, 0.0f, 0.0f });
-		clearValues[1].color.setFloat32({ 0.0f, 0.0f, 0.0f, 0.0f });
-		clearValues[2].color.setFloat32({ 0.0f, 0.0f, 0.0f, 0.0f });
-		clearValues[3].depthStencil.setDepth(1.0f).setStencil(0);
+		bool merged = mCompositionMode == CompositionMode::subpass;
 
-		std::array<vk::DescriptorSet, 2> descriptorSets = {
-			mResource.descriptorSet.get("camera"),
-			mResource.descriptorSet.get("model")
-		};
+		std::vector<vk::ClearValue> clearValues(merged ? 1 : mReconstructPosition ? 3 : 4);
+		for (auto& value : clearValues)
+			value.color.setFloat32({ 0.0f, 0.0f, 0.0f, 0.0f });
+		clearValues.back().depthStencil.setDepth(mReversedDepth ? 0.0f : 1.0f).setStencil(0);
+
+		// empty pixels of visibility buffer are discarded by resolve
+		if (mVisibilityBuffer)
+			clearValues.emplace_back().color.setUint32({ 0xFFFFFFFF, 0, 0, 0 });
 		
 		vk::RenderPassBeginInfo renderpassInfo;
-		renderpassInfo.renderPass = *mGBufferRenderpass;
-		renderpassInfo.framebuffer = *mGBufferFramebuffer;
+		renderpassInfo.renderPass = merged ? *mDepthPrepassRenderpass : *mGBufferRenderpass;
+		renderpassInfo.framebuffer = merged ? *mDepthPrepassFramebuffer : *mGBufferFramebuffer;
 		renderpassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
-		renderpassInfo.renderArea.extent = mSwapchainExtent;
+		renderpassInfo.renderArea.extent = mRenderExtent;
 		renderpassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderpassInfo.pClearValues = clearValues.data();
 
-		auto pipelineLayout = mResource.pipelineLayout.get("gbuffers");
 		auto& cmd = mResource.cmd.get("gBuffer");
 		
 		cmd.begin(beginInfo);
+
+		if (mStatisticsQueryPool)
+			cmd.resetQueryPool(*mStatisticsQueryPool, 0, 1);
+
+		const auto& model = mScene.getModel();
+
+		// separate depth prepass culls meshlets for both passes and starts the frame
+		if (!mDepthPrepass)
+		{
+			writeFrameTimestamp(cmd);
+			recordMeshletCulling(cmd);
+		}
+
 		cmd.beginRenderPass(renderpassInfo, vk::SubpassContents::eInline);
-		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("gbuffers"));
-		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSets, nullptr);
+		setRenderViewport(cmd, mRenderExtent);
 
-		for (const auto& part : mScene.getGeometry())
+		if (mStatisticsQueryPool)
+			cmd.beginQuery(*mStatisticsQueryPool, 0, {});
+
+		if (mVisibilityBuffer)
 		{
-			auto materialSet = mResource.descriptorSet.get(part.materialDescriptorSetKey);
+			// triangle ID is part index above primitive index of its draw
+			std::array<uint32_t, 2> pushConstants = {
+				getVisibilityBits().y,
+				static_cast<uint32_t>(model.getIndexBufferSection().offset / sizeof(uint32_t))
+			};
+
+			auto gbufferLayout = mResource.pipelineLayout.get("gbuffers");
+			cmd.pushConstants(gbufferLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), pushConstants.data());
+
+			recordGeometryDraws(cmd, "visibility");
+
+			cmd.nextSubpass(vk::SubpassContents::eInline);
 
-			cmd.bindVertexBuffers(0, part.vertexBufferSection.handle, part.vertexBufferSection.offset);
-			cmd.bindIndexBuffer(part.indexBufferSection.handle, part.indexBufferSection.offset, vk::IndexType::eUint32);
-			cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, static_cast<uint32_t>(descriptorSets.size()), materialSet, nullptr);
-			cmd.drawIndexed(part.indexCount, 1, 0, 0, 0);
+			std::array<vk::DescriptorSet, 4> resolveSets = {
+				mResource.descriptorSet.get("camera"),
+				mResource.descriptorSet.get("model"),
+				mResource.descriptorSet.get("material"),
+				mResource.descriptorSet.get("visibility")
+			};
+
+			auto resolveLayout = mResource.pipelineLayout.get("visibility_resolve");
+
+			cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get(model.hasPackedVertices() ? "visibility_resolve_packed" : "visibility_resolve"));
+			cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, resolveLayout, 0, resolveSets, nullptr);
+			cmd.pushConstants(resolveLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(pushConstants), pushConstants.data());
+			cmd.draw(4, 1, 0, 0);
 		}
+		else
+			recordGeometryDraws(cmd, merged ? "depth_prepass" : "gbuffers", merged);
+
+		if (mStatisticsQueryPool)
+			cmd.endQuery(*mStatisticsQueryPool, 0);
 
 		cmd.endRenderPass();
 		cmd.end();
 	}
 
-	// debug
+	// separate depth prepass, light culling waits only for it and overlaps G-buffer shading
+	if (mDepthPrepass)
 	{
-		vk::CommandBufferInheritanceInfo inheritanceInfo;
-		inheritanceInfo.renderPass = *mCompositionRenderpass;
-		inheritanceInfo.subpass = 0;
+		vk::CommandBufferBeginInfo beginInfo;
+		beginInfo.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+
+		vk::ClearValue clearValue;
+		clearValue.depthStencil.setDepth(mReversedDepth ? 0.0f : 1.0f).setStencil(0);
+
+		vk::RenderPassBeginInfo renderpassInfo;
+		renderpassInfo.renderPass = *mDepthPrepassRenderpass;
+		renderpassInfo.framebuffer = *mDepthPrepassFramebuffer;
+		renderpassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+		renderpassInfo.renderArea.extent = mRenderExtent;
+		renderpassInfo.clearValueCount = 1;
+		renderpassInfo.pClearValues = &clearValue;
+
+		auto& cmd = mResource.cmd.get("depthPrepass");
+
+		cmd.begin(beginInfo);
+		writeFrameTimestamp(cmd);
+		recordMeshletCulling(cmd);
+		cmd.beginRenderPass(renderpassInfo, vk::SubpassContents::eInline);
+		setRenderViewport(cmd, mRenderExtent);
+		recordGeometryDraws(cmd, "depth_prepass", true);
+		cmd.endRenderPass();
+		cmd.end();
+	}
+
+	// debug
+	{
+		vk::CommandBufferInheritanceInfo inheritanceInfo;
+		inheritanceInfo.renderPass = *mCompositionRenderpass;
+		inheritanceInfo.subpass = 0;
 
 		vk::CommandBufferBeginInfo beginInfo;
 		beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue;
 		beginInfo.pInheritanceInfo = &inheritanceInfo;
 		
-		std::array<vk::DescriptorSet, 2> descriptorSets = {
+		std::array<vk::DescriptorSet, 3> descriptorSets = {
 			mResource.descriptorSet.get("debug"),
 			mResource.descriptorSet.get("composition_front"),
+			mResource.descriptorSet.get("camera")
 		};
 
 		// record command buffers
@@ -1220,12 +2422,46 @@ void Renderer::createSyncPrimitives()
 	mResource.semaphore.add("lightSortingFinished");
 	mResource.semaphore.add("lightCopyFinished");
 	mResource.semaphore.add("gBufferFinished");
+	mResource.semaphore.add("depthPrepassFinished");
 	mResource.semaphore.add("renderFinished", count);
 	mResource.semaphore.add("imageAvailable", count);
 
 	mResource.fence.add("renderFinished", count);
 }
 
+void Renderer::createQueryPools()
+{
+	// composition begin and end timestamps, end of reduced resolution diffuse pass, frame begin
+	auto limits = mContext.getPhysicalDevice().getProperties().limits;
+	if (limits.timestampComputeAndGraphics)
+	{
+		vk::QueryPoolCreateInfo queryPoolInfo;
+		queryPoolInfo.queryType = vk::QueryType::eTimestamp;
+		queryPoolInfo.queryCount = 4;
+
+		mTimestampQueryPool = mContext.getDevice().createQueryPoolUnique(queryPoolInfo);
+		mTimestampPeriod = limits.timestampPeriod;
+	}
+
+	if (mContext.getEnabledFeatures().pipelineStatisticsQuery)
+	{
+		vk::QueryPoolCreateInfo queryPoolInfo;
+		queryPoolInfo.queryType = vk::QueryType::ePipelineStatistics;
+		queryPoolInfo.queryCount = 1;
+		queryPoolInfo.pipelineStatistics = vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations;
+
+		mStatisticsQueryPool = mContext.getDevice().createQueryPoolUnique(queryPoolInfo);
+	}
+
+	// results are read every frame, first ones before any frame resets or writes them
+	auto cmd = mUtility.beginSingleTimeCommands();
+	if (mTimestampQueryPool)
+		cmd.resetQueryPool(*mTimestampQueryPool, 0, 4); // includes frame begin, which only G-buffer commands reset
+	if (mStatisticsQueryPool)
+		cmd.resetQueryPool(*mStatisticsQueryPool, 0, 1);
+	mUtility.endSingleTimeCommands(cmd);
+}
+
 void Renderer::createComputePipeline()
 {
 	std::array<vk::DescriptorSetLayout, 2> setLayouts = { 
@@ -1236,15 +2472,22 @@ void Renderer::createComputePipeline()
 	// create specialization constants
 	std::vector<vk::SpecializationMapEntry> entries;
 	entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Tile Size
-	entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Y_slices
+	entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Depth slices
 	entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // WG size
+	entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Tiled depth mode
+	entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Cluster sphere test
+	entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Spot lights
+	entries.emplace_back(static_cast<uint32_t>(entries.size()), static_cast<uint32_t>(entries.size() * 4), 4); // Reversed depth
 
 	uint32_t groupSize = mCurrentTileSize <= 32 ? mCurrentTileSize : 32;
-	float ySlices = std::log(1.0f + (2.f * std::tanf(glm::radians(45.f / 2.f))) / mTileCount.y);  // todo FOV as parameter
 	std::vector<uint32_t> constantData = {
 		mCurrentTileSize, 
-		*reinterpret_cast<uint32_t*>(&ySlices),
+		mDepthSlices,
 		groupSize,
+		static_cast<uint32_t>(BaseApp::getInstance().getUI().mContext.tiledDepthMode),
+		static_cast<uint32_t>(BaseApp::getInstance().getUI().mContext.clusterSphereTest),
+		BaseApp::getInstance().getUI().mContext.spotLightFraction > 0.0f,
+		mReversedDepth,
 	};
 	
 	vk::SpecializationInfo specializationInfo;
@@ -1291,8 +2534,117 @@ void Renderer::createComputePipeline()
 	createPipeline("sort_bitonic", sizeof(uint32_t));
 	createPipeline("sort_mergeBitonic", 2 * sizeof(uint32_t));
 	createPipeline("bvh", 3 * sizeof(uint32_t));
-	createPipeline("lightculling", 11 * sizeof(uint32_t));
-	createPipeline("lightculling_tiled", sizeof(uint32_t));
+	createPipeline("lightculling", 12 * sizeof(uint32_t));
+	createPipeline("lightculling_tiled", 2 * sizeof(uint32_t));
+
+	// depth keyed sort and binning
+	{
+		auto depthEntries = entries;
+		depthEntries.emplace_back(static_cast<uint32_t>(depthEntries.size()), static_cast<uint32_t>(depthEntries.size() * 4), 4); // Depth key
+
+		auto depthConstantData = constantData;
+		depthConstantData.emplace_back(VK_TRUE);
+
+		vk::SpecializationInfo depthSpecializationInfo;
+		depthSpecializationInfo.mapEntryCount = static_cast<uint32_t>(depthEntries.size());
+		depthSpecializationInfo.pMapEntries = depthEntries.data();
+		depthSpecializationInfo.dataSize = depthConstantData.size() * 4;
+		depthSpecializationInfo.pData = depthConstantData.data();
+
+		stageInfo.module = mResource.shaderModule.add("data/sort_bitonic.comp");
+		stageInfo.pSpecializationInfo = &depthSpecializationInfo;
+
+		vk::ComputePipelineCreateInfo pipelineInfo;
+		pipelineInfo.stage = stageInfo;
+		pipelineInfo.layout = mResource.pipelineLayout.get("sort_bitonic");
+		pipelineInfo.basePipelineIndex = -1;
+
+		mResource.pipeline.add("sort_bitonic_depth", *mPipelineCache, pipelineInfo);
+
+		std::array<vk::DescriptorSetLayout, 3> zbinSetLayouts = {
+			mResource.descriptorSetLayout.get("camera"),
+			mResource.descriptorSetLayout.get("lightculling"),
+			mResource.descriptorSetLayout.get("zbin")
+		};
+
+		vk::PushConstantRange pushConstantRange;
+		pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+		pushConstantRange.size = 2 * sizeof(uint32_t);
+
+		vk::PipelineLayoutCreateInfo layoutInfo;
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(zbinSetLayouts.size());
+		layoutInfo.pSetLayouts = zbinSetLayouts.data();
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		stageInfo.module = mResource.shaderModule.add("data/zbin.comp");
+		stageInfo.pSpecializationInfo = &specializationInfo;
+
+		pipelineInfo.stage = stageInfo;
+		pipelineInfo.layout = mResource.pipelineLayout.add("zbin", layoutInfo);
+
+		mResource.pipeline.add("zbin", *mPipelineCache, pipelineInfo);
+	}
+
+	// meshlet culling works on scene geometry instead of lights
+	{
+		std::array<vk::DescriptorSetLayout, 3> meshletSetLayouts = {
+			mResource.descriptorSetLayout.get("camera"),
+			mResource.descriptorSetLayout.get("model"),
+			mResource.descriptorSetLayout.get("meshlets")
+		};
+
+		stageInfo.module = mResource.shaderModule.add("data/meshlet_culling.comp");
+		stageInfo.pSpecializationInfo = nullptr;
+
+		vk::PushConstantRange pushConstantRange;
+		pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+		pushConstantRange.size = sizeof(uint32_t);
+
+		vk::PipelineLayoutCreateInfo layoutInfo;
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(meshletSetLayouts.size());
+		layoutInfo.pSetLayouts = meshletSetLayouts.data();
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		vk::ComputePipelineCreateInfo pipelineInfo;
+		pipelineInfo.stage = stageInfo;
+		pipelineInfo.layout = mResource.pipelineLayout.add("meshlet_culling", layoutInfo);
+		pipelineInfo.basePipelineIndex = -1;
+
+		mResource.pipeline.add("meshlet_culling", *mPipelineCache, pipelineInfo);
+	}
+
+	// clustered composition, constants match composition fragment shaders
+	if (mCompositionMode == CompositionMode::compute)
+	{
+		std::array<vk::DescriptorSetLayout, 3> compositionSetLayouts = {
+			mResource.descriptorSetLayout.get("camera"),
+			mResource.descriptorSetLayout.get("composition"),
+			mResource.descriptorSetLayout.get("composed")
+		};
+
+		constantData[2] = mReconstructPosition;
+		std::string defines = BaseApp::getInstance().getUI().getDebugIndex() == DebugStates::lightCount ? "#define HEATMAP\n" : "";
+		if (BaseApp::getInstance().getUI().mContext.spotLightFraction > 0.0f)
+			defines += "#define SPOT_LIGHTS\n";
+		if (BaseApp::getInstance().getUI().mContext.lightLod)
+			defines += "#define LIGHT_LOD\n";
+
+		stageInfo.module = mResource.shaderModule.add("data/composite_clustered.comp", defines);
+		stageInfo.pSpecializationInfo = &specializationInfo;
+
+		vk::PipelineLayoutCreateInfo layoutInfo;
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(compositionSetLayouts.size());
+		layoutInfo.pSetLayouts = compositionSetLayouts.data();
+
+		vk::ComputePipelineCreateInfo pipelineInfo;
+		pipelineInfo.stage = stageInfo;
+		pipelineInfo.layout = mResource.pipelineLayout.add("composition_compute", layoutInfo);
+		pipelineInfo.basePipelineIndex = -1;
+
+		mResource.pipeline.add("composition_compute", *mPipelineCache, pipelineInfo);
+	}
 }
 
 void Renderer::createComputeCommandBuffer()
@@ -1322,6 +2674,7 @@ void Renderer::createComputeCommandBuffer()
 		// lightculling tiled
 		allocInfo.commandPool = mContext.getDynamicCommandPool();
 		mResource.cmd.add("lightculling_tiled", allocInfo);
+		mResource.cmd.add("lightculling_zbin", allocInfo);
 	}
 
 	// Record command buffer
@@ -1344,7 +2697,7 @@ void Renderer::createComputeCommandBuffer()
 
 		vk::MemoryBarrier transferToComputeBarrier;
 		transferToComputeBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-		transferToComputeBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		transferToComputeBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
 
 		vk::CommandBufferInheritanceInfo inheritanceInfo;
 
@@ -1360,6 +2713,7 @@ void Renderer::createComputeCommandBuffer()
 			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eByRegion , copyBarrier, nullptr, nullptr); 
 			cmd.fillBuffer(*mClusteredBuffer.handle, mPageTableOffset + 4, 8, 1);
 			cmd.fillBuffer(*mClusteredBuffer.handle, mUniqueClustersOffset, 16, 1);
+			cmd.fillBuffer(*mClusteredBuffer.handle, mClusterStatsOffset + 4, 4, 0xFFFFFFFF); // min depth, rest of stats is zeroed above
 			
 			cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mResource.pipelineLayout.get("pt_flag"), 0, descriptorSets, nullptr);
 			cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("pt_flag"));
@@ -1368,7 +2722,7 @@ void Renderer::createComputeCommandBuffer()
 			
 			cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("pt_alloc"));
 			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eByRegion, barrier, nullptr, nullptr);
-			cmd.dispatch(4, 1, 1);
+			cmd.dispatch((mPageTableEntries - 1) / 512 + 1, 1, 1);
 			
 			cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("pt_store"));
 			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eByRegion, barrier, nullptr, nullptr);
@@ -1386,18 +2740,55 @@ void Renderer::updateUniformBuffers()
 {
 	// update camera ubo
 	{
+		const auto& camera = mScene.getCamera();
 		auto data = reinterpret_cast<CameraUBO*>(mContext.getDevice().mapMemory(*mCameraStagingBuffer.memory, 0, sizeof(CameraUBO)));
-		data->view = mScene.getCamera().getViewMatrix();
-		data->projection = glm::perspective(glm::radians(45.0f), mSwapchainExtent.width / static_cast<float>(mSwapchainExtent.height), 0.05f, 100.0f);
-		data->projection[1][1] *= -1; //since the Y axis of Vulkan NDC points down
+		data->view = camera.getViewMatrix();
+		data->projection = camera.getProjectionMatrix(mSwapchainExtent.width / static_cast<float>(mSwapchainExtent.height), mReversedDepth);
 		data->invProj = glm::inverse(data->projection);
-		data->cameraPosition = mScene.getCamera().getPosition();
-		data->screenSize = {mSwapchainExtent.width, mSwapchainExtent.height};
+		data->cameraPosition = camera.getPosition();
+		data->screenSize = {mRenderExtent.width, mRenderExtent.height};
+		data->zNear = camera.getNear();
+		data->zFar = camera.getFar();
+
+		// clusters keep roughly cubic shape, slices get thicker when range doesn't fit to key bits
+		glm::vec2 range = getClusterDepthRange(data->view);
+		data->sliceNear = range.x;
+		data->sliceScale = std::max(std::log(1.0f + 2.0f * std::tan(camera.getFov() / 2.0f) / mTileCount.y), std::log(range.y / range.x) / (mDepthSlices - 2));
+		data->keyBitsX = mClusterKeyBits.x;
+		data->keyBitsY = mClusterKeyBits.y;
+		data->pageSizePower = mPageSizePower;
+
+		// sorting quantizes light positions inside view space box of light bounds
+		const auto& context = BaseApp::getInstance().getUI().mContext;
+		glm::vec3 boundsMin(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			glm::vec3 corner = { (i & 1) ? context.lightBoundMax.x : context.lightBoundMin.x, (i & 2) ? context.lightBoundMax.y : context.lightBoundMin.y, (i & 4) ? context.lightBoundMax.z : context.lightBoundMin.z };
+			corner = glm::vec3(data->view * glm::vec4(corner, 1.0f));
+			boundsMin = glm::min(boundsMin, corner);
+			boundsMax = glm::max(boundsMax, corner);
+		}
+
+		data->lightBoundsMin = boundsMin;
+		data->lightBoundsExtent = glm::max(boundsMax - boundsMin, glm::vec3(1e-3f));
 
 		mContext.getDevice().unmapMemory(*mCameraStagingBuffer.memory);
 		mUtility.copyBuffer(*mCameraStagingBuffer.handle, *mCameraUniformBuffer.handle, sizeof(CameraUBO));
 	}
 
+	// select mesh lods, draw commands are read by G-buffer pass of this frame
+	{
+		auto& context = BaseApp::getInstance().getUI().mContext;
+		auto scale = mScene.getScale();
+
+		float projectionScale = mRenderExtent.height / (2.0f * std::tan(mScene.getCamera().getFov() / 2.0f)); // pixels per unit at distance 1
+		float threshold = context.meshLod ? context.lodErrorThreshold : -1.0f; // negative keeps full resolution
+
+		// scale is uniform, error and distance are compared in object space
+		mGBufferTriangles = mScene.getModel().selectLods(mScene.getCamera().getPosition() / scale, projectionScale, threshold);
+	}
+
 	// update debug buffer, if dirty bit is set
 	if (BaseApp::getInstance().getUI().debugStateUniformNeedsUpdate())
 	{
@@ -1415,6 +2806,139 @@ void Renderer::updateUniformBuffers()
 	}
 }
 
+glm::vec2 Renderer::getClusterDepthRange(const glm::mat4& view) const
+{
+	const auto& camera = mScene.getCamera();
+	glm::vec2 range = { camera.getNear(), camera.getFar() };
+
+	switch (BaseApp::getInstance().getUI().mContext.depthSlicing)
+	{
+	case DepthSlicing::depthBounds:
+		if (mDepthBounds.y > 0.0f)
+			range = mDepthBounds;
+		break;
+
+	case DepthSlicing::sceneBounds:
+	{
+		// bounding spheres of mesh parts, model matrix is uniform scale
+		auto scale = mScene.getScale();
+		range = { camera.getFar(), camera.getNear() };
+
+		for (const auto& part : mScene.getModel().getMeshParts())
+		{
+			float depth = -(view * glm::vec4(glm::vec3(part.boundingSphere) * scale, 1.0f)).z;
+			float radius = part.boundingSphere.w * scale.x;
+
+			range.x = std::min(range.x, depth - radius);
+			range.y = std::max(range.y, depth + radius);
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	// first slice spans from near plane to range start, last one from range end to far plane
+	range.x = glm::clamp(range.x, camera.getNear(), camera.getFar());
+	range.y = glm::clamp(range.y, range.x, camera.getFar());
+
+	return range;
+}
+
+void Renderer::readQueryResults()
+{
+	// previous frame is finished, general queue waits idle in updateLights
+	if (mStatisticsQueryPool)
+	{
+		uint64_t invocations;
+		auto result = mContext.getDevice().getQueryPoolResults(*mStatisticsQueryPool, 0, 1, sizeof(uint64_t), &invocations, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+		if (result == vk::Result::eSuccess)
+			mGBufferVertexInvocations = invocations;
+	}
+
+	if (BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::tiled)
+	{
+		auto data = static_cast<uint32_t*>(mContext.getDevice().mapMemory(*mTiledStatsBuffer.memory, 0, 3 * sizeof(uint32_t)));
+		mTiledLightReferences = data[0];
+		mTiledOverflow = data[1];
+		mTiledMaxLights = data[2];
+		mContext.getDevice().unmapMemory(*mTiledStatsBuffer.memory);
+	}
+
+	if (BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::clustered)
+	{
+		auto data = static_cast<uint32_t*>(mContext.getDevice().mapMemory(*mClusterStatsBuffer.memory, 0, 6 * sizeof(uint32_t)));
+		mUniqueClusterCount = data[0] > 0 ? data[0] - 1 : 0; // counter starts at one
+		mClusterLightReferences = data[1];
+		mClusterMaxLights = data[4];
+		mClusterPageCount = data[5];
+
+		// empty when only background was rendered
+		if (data[2] <= data[3])
+			mDepthBounds = { *reinterpret_cast<float*>(&data[2]), *reinterpret_cast<float*>(&data[3]) };
+		mContext.getDevice().unmapMemory(*mClusterStatsBuffer.memory);
+	}
+
+	if (BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::zbin)
+	{
+		auto data = static_cast<uint32_t*>(mContext.getDevice().mapMemory(*mZBinStatsBuffer.memory, 0, sizeof(uint32_t)));
+		mZBinLightReferences = data[0];
+		mContext.getDevice().unmapMemory(*mZBinStatsBuffer.memory);
+	}
+
+	if (mTimestampQueryPool)
+	{
+		std::array<uint64_t, 3> timestamps;
+		uint32_t count = mDiffuseScale > 1 ? 3 : 2;
+		auto result = mContext.getDevice().getQueryPoolResults(*mTimestampQueryPool, 0, count, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+		// smoothed, so variants can be compared on a still scene
+		if (result == vk::Result::eSuccess)
+		{
+			float time = static_cast<float>(timestamps[1] - timestamps[0]) * mTimestampPeriod * 1e-6f;
+			mCompositionTime = mCompositionTime > 0.0f ? glm::mix(mCompositionTime, time, 0.05f) : time;
+
+			if (count > 2)
+			{
+				float diffuseTime = static_cast<float>(timestamps[2] - timestamps[0]) * mTimestampPeriod * 1e-6f;
+				mDiffuseTime = mDiffuseTime > 0.0f ? glm::mix(mDiffuseTime, diffuseTime, 0.05f) : diffuseTime;
+			}
+
+			// G-buffer and composition share general queue, so their timestamps compare
+			uint64_t frameBegin;
+			if (mContext.getDevice().getQueryPoolResults(*mTimestampQueryPool, 3, 1, sizeof(uint64_t), &frameBegin, sizeof(uint64_t), vk::QueryResultFlagBits::e64) == vk::Result::eSuccess)
+			{
+				float frameTime = static_cast<float>(timestamps[1] - frameBegin) * mTimestampPeriod * 1e-6f;
+				mFrameTime = mFrameTime > 0.0f ? glm::mix(mFrameTime, frameTime, 0.1f) : frameTime;
+			}
+		}
+	}
+}
+
+void Renderer::writeCompositionTimestamp(vk::CommandBuffer cmd, bool begin)
+{
+	if (!mTimestampQueryPool)
+		return;
+
+	if (begin)
+	{
+		// first stage blocked by light culling semaphore, so culling is not measured. Merged pass
+		// contains G-buffer subpass, so its time is reported as merged pass instead
+		auto stage = vk::PipelineStageFlagBits::eFragmentShader;
+		if (mCompositionMode == CompositionMode::subpass)
+			stage = vk::PipelineStageFlagBits::eDrawIndirect;
+		else if (mCompositionMode == CompositionMode::compute && BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::clustered)
+			stage = vk::PipelineStageFlagBits::eComputeShader;
+
+		cmd.resetQueryPool(*mTimestampQueryPool, 0, 3); // frame begin is reset by G-buffer commands
+		cmd.writeTimestamp(stage, *mTimestampQueryPool, 0);
+	}
+	else
+		cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *mTimestampQueryPool, 1);
+}
+
 void Renderer::updateLights(const std::vector<PointLight>& lights)
 {	
 	mLightsCount = BaseApp::getInstance().getUI().mContext.lightsCount;
@@ -1455,7 +2979,7 @@ void Renderer::updateLights(const std::vector<PointLight>& lights)
 	mUtility.recordCopyBuffer(cmd, *mPointLightsStagingBuffer.handle, *mLightsBuffers.handle, memorySize, 0, mPointLightsOffset);
 		
 	// release ownership
-	if (context.cullingMethod != CullingMethod::clustered)
+	if (!sortsLights(context.cullingMethod))
 		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlagBits::eByRegion, nullptr, after, nullptr);
 
 	cmd.end();
@@ -1493,7 +3017,8 @@ void Renderer::drawFrame()
 
 	submitGbufferCmds(); 
 
-	if (BaseApp::getInstance().getUI().getDebugIndex() == DebugStates::disabled)
+	auto debugState = BaseApp::getInstance().getUI().getDebugIndex();
+	if (debugState == DebugStates::disabled || debugState == DebugStates::lightCount || mCompositionMode == CompositionMode::subpass)
 	{
 		if (BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::clustered)
 		{
@@ -1505,6 +3030,11 @@ void Renderer::drawFrame()
 			submitTiledLightCullingCmds(imageIndex);
 			submitTiledCompositionCmds(imageIndex);
 		}
+		else if (BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::zbin)
+		{
+			submitZBinLightCullingCmds(imageIndex);
+			submitZBinCompositionCmds(imageIndex);
+		}
 		else
 			submitDeferredCompositionCmds(imageIndex);
 	}
@@ -1580,17 +3110,32 @@ mResource.descriptorSet.get(mLightBufferSwapUsed)
 	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mResource.pipelineLayout.get("lightculling"), 0, descriptorSets, nullptr);
 	cmd.pushConstants(mResource.pipelineLayout.get("lightculling"), vk::ShaderStageFlagBits::eCompute, 0, 4, &mMaxBVHLevel);
 	cmd.pushConstants(mResource.pipelineLayout.get("lightculling"), vk::ShaderStageFlagBits::eCompute, 4, static_cast<uint32_t>(mLevelParam.size() * 8), mLevelParam.data());
+
+	// behind level params, which always take 5 slots
+	const auto& context = BaseApp::getInstance().getUI().mContext;
+	float lodThreshold = context.lightLod ? context.lightLodThreshold : 0.0f;
+	cmd.pushConstants(mResource.pipelineLayout.get("lightculling"), vk::ShaderStageFlagBits::eCompute, 44, 4, &lodThreshold);
 	
 	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eDrawIndirect, vk::DependencyFlagBits::eByRegion, nullptr, copyBarrier, nullptr);
 	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect, vk::DependencyFlagBits::eByRegion, barrier, nullptr, nullptr);
 	
 	cmd.dispatchIndirect(*mClusteredBuffer.handle, mUniqueClustersOffset + 4);
 
+	// unique cluster count, light references, depth bounds, longest list and allocated pages are read on host next frame
+	vk::MemoryBarrier readbackBarrier;
+	readbackBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	readbackBarrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eByRegion, readbackBarrier, nullptr, nullptr);
+	mUtility.recordCopyBuffer(cmd, *mClusteredBuffer.handle, *mClusterStatsBuffer.handle, sizeof(uint32_t), mUniqueClustersOffset);
+	mUtility.recordCopyBuffer(cmd, *mClusteredBuffer.handle, *mClusterStatsBuffer.handle, 4 * sizeof(uint32_t), mClusterStatsOffset, sizeof(uint32_t));
+	mUtility.recordCopyBuffer(cmd, *mClusteredBuffer.handle, *mClusterStatsBuffer.handle, sizeof(uint32_t), mPageTableOffset, 5 * sizeof(uint32_t));
+
 	cmd.end();
 	
 	std::vector<vk::PipelineStageFlags> waitStages = {vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eDrawIndirect};
 	std::vector<vk::Semaphore> waitSemaphores = { 
-		mResource.semaphore.get("gBufferFinished"), 
+		mResource.semaphore.get(mDepthPrepass ? "depthPrepassFinished" : "gBufferFinished"), 
 		mResource.semaphore.get("lightSortingFinished")
 	};
 
@@ -1610,33 +3155,61 @@ void Renderer::submitClusteredCompositionCmds(size_t imageIndex)
 {
 	auto& cmd = mResource.cmd.get("primaryComposition", imageIndex);
 
-	vk::RenderPassBeginInfo renderpassInfo;
-	renderpassInfo.renderPass = *mCompositionRenderpass;
-	renderpassInfo.framebuffer = *mSwapchainFramebuffers[imageIndex];
-	renderpassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
-	renderpassInfo.renderArea.extent = mSwapchainExtent;
-	
-	std::array<vk::DescriptorSet, 2> descriptorSets = {
+	std::vector<vk::DescriptorSet> descriptorSets = {
 		mResource.descriptorSet.get("camera"),
 		mResource.descriptorSet.get(mLightBufferSwapUsed == "lightculling_front" ? "composition_front" : "composition_back")
 	};
-	
-	std::array<vk::ClearValue, 1> clearValues;
-	clearValues[0].color.setFloat32({ 1.0f, 0.8f, 0.4f, 1.0f });
 
-	renderpassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-	renderpassInfo.pClearValues = clearValues.data();
+	if (mCompositionMode == CompositionMode::subpass)
+		descriptorSets.emplace_back(mResource.descriptorSet.get("gbuffer_input"));
 
 	cmd.begin(vk::CommandBufferBeginInfo{});
 	BaseApp::getInstance().getUI().copyDrawData(cmd);
+	writeCompositionTimestamp(cmd, true);
 
-	cmd.beginRenderPass(renderpassInfo, vk::SubpassContents::eInline);
-	
-	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("composition"));
-	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get("composition"), 0, descriptorSets, nullptr);
-	cmd.draw(4, 1, 0, 0);
+	if (mCompositionMode == CompositionMode::compute)
+	{
+		descriptorSets.emplace_back(mResource.descriptorSet.get("composed"));
+
+		// previous content is not needed
+		vk::ImageMemoryBarrier imageBarrier;
+		imageBarrier.oldLayout = vk::ImageLayout::eUndefined;
+		imageBarrier.newLayout = vk::ImageLayout::eGeneral;
+		imageBarrier.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+		imageBarrier.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = *mComposedImage.handle;
+		imageBarrier.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, imageBarrier);
+
+		cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("composition_compute"));
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mResource.pipelineLayout.get("composition_compute"), 0, descriptorSets, nullptr);
+		cmd.dispatch((mSwapchainExtent.width - 1) / 16 + 1, (mSwapchainExtent.height - 1) / 16 + 1, 1);
+
+		imageBarrier.oldLayout = imageBarrier.newLayout;
+		imageBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+		imageBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, imageBarrier);
+
+		beginCompositionRenderPass(cmd, imageIndex);
+		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("present"));
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get("present"), 0, descriptorSets.back(), nullptr);
+		cmd.draw(4, 1, 0, 0);
+	}
+	else
+	{
+		recordDiffusePass(cmd, "composition", descriptorSets);
+		beginCompositionRenderPass(cmd, imageIndex);
+		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("composition"));
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get("composition"), 0, descriptorSets, nullptr);
+		cmd.draw(4, 1, 0, 0);
+	}
 	
-	cmd.nextSubpass(vk::SubpassContents::eInline);
+	writeCompositionTimestamp(cmd, false);
+	nextCompositionSubpass(cmd, imageIndex);
 	BaseApp::getInstance().getUI().recordCommandBuffer(cmd);
 	cmd.endRenderPass();
 
@@ -1649,16 +3222,30 @@ void Renderer::submitClusteredCompositionCmds(size_t imageIndex)
 	after.srcQueueFamilyIndex = mContext.getQueueFamilyIndices().generalFamily;
 	after.dstQueueFamilyIndex = mContext.getQueueFamilyIndices().computeFamily;
 	
-	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlagBits::eByRegion, nullptr, after, nullptr);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlagBits::eByRegion, nullptr, after, nullptr);
 	cmd.end();
 
 
 	vk::PipelineStageFlags waitStages = vk::PipelineStageFlagBits::eFragmentShader;
+	if (mCompositionMode == CompositionMode::subpass) // G-buffer subpass is ordered after prepass through light culling
+		waitStages |= vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+	else if (mCompositionMode == CompositionMode::compute)
+		waitStages |= vk::PipelineStageFlagBits::eComputeShader;
+
+	std::vector<vk::PipelineStageFlags> waitStageMasks = { waitStages };
+	std::vector<vk::Semaphore> waitSemaphores = { mResource.semaphore.get("lightCullingFinished") };
+
+	// G-buffer shading overlapped light culling after separate depth prepass
+	if (mDepthPrepass)
+	{
+		waitStageMasks.emplace_back(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader);
+		waitSemaphores.emplace_back(mResource.semaphore.get("gBufferFinished"));
+	}
 
 	vk::SubmitInfo submitInfo;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &mResource.semaphore.get("lightCullingFinished");
-	submitInfo.pWaitDstStageMask = &waitStages;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStageMasks.data();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &cmd;
 	submitInfo.signalSemaphoreCount = 1;
@@ -1700,7 +3287,8 @@ mResource.descriptorSet.get("lightculling_front")
 	uint32_t sortingKernelsCount = (1023 + mLightsCount) / 1024;
 
 	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mResource.pipelineLayout.get("pt_flag"), 0, descriptorSets, nullptr);	
-	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("sort_bitonic"));
+	bool zbin = BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::zbin;
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get(zbin ? "sort_bitonic_depth" : "sort_bitonic"));
 	cmd.pushConstants(mResource.pipelineLayout.get("sort_bitonic"), vk::ShaderStageFlagBits::eCompute, 0, 4, &mLightsCount);
 	cmd.dispatch(sortingKernelsCount, 1, 1);
 	
@@ -1727,47 +3315,50 @@ mResource.descriptorSet.get("lightculling_front")
 	mLightBufferSwapUsed = (mLightBufferSwapUsed == "lightculling_front") ? "lightculling_back" : "lightculling_front";
 	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mResource.pipelineLayout.get("pt_flag"), 1, mResource.descriptorSet.get(mLightBufferSwapUsed), nullptr);
 
-	// BVH
-	auto& bvhLayout = mResource.pipelineLayout.get("bvh");
-	mMaxBVHLevel = (mLightsCount > mSubGroupSize) ? 1 : 0;
-	const uint32_t subgroupAlignedLightCount = ((mLightsCount - 1) / mSubGroupSize + 1) * mSubGroupSize - 1;
-
-	auto createdNodes = [this](uint32_t elementsCount) { return (elementsCount - 1) / mSubGroupSize + 1; };
-	auto groupsCount = [](uint32_t levelNodeCount)
+	// BVH, z-binning only needs sorted lights
+	if (!zbin)
 	{
-		const uint32_t bvhThreadCount = 512;
-		return (levelNodeCount - 1) / bvhThreadCount + 1;
-	};
+		auto& bvhLayout = mResource.pipelineLayout.get("bvh");
+		mMaxBVHLevel = (mLightsCount > mSubGroupSize) ? 1 : 0;
+		const uint32_t subgroupAlignedLightCount = ((mLightsCount - 1) / mSubGroupSize + 1) * mSubGroupSize - 1;
 
+		auto createdNodes = [this](uint32_t elementsCount) { return (elementsCount - 1) / mSubGroupSize + 1; };
+		auto groupsCount = [](uint32_t levelNodeCount)
+		{
+			const uint32_t bvhThreadCount = 512;
+			return (levelNodeCount - 1) / bvhThreadCount + 1;
+		};
 
-	struct
-	{
-		uint32_t count;
-		uint32_t offset;
-		uint32_t nextOffset;
-	} pushConstants = {
-		mLightsCount,
-		0,
-		subgroupAlignedLightCount / 6 + 1,
-	};
-	
-	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("bvh"));
-	cmd.pushConstants(bvhLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
-	barrier(cmd);
-	cmd.dispatch(groupsCount(mLightsCount), 1, 1);
 
-	mLevelParam.emplace_back(mLightsCount, 0);
-	mLevelParam.emplace_back(createdNodes(mLightsCount), pushConstants.nextOffset);
+		struct
+		{
+			uint32_t count;
+			uint32_t offset;
+			uint32_t nextOffset;
+		} pushConstants = {
+			mLightsCount,
+			0,
+			subgroupAlignedLightCount / 6 + 1,
+		};
 	
-	for ( ;mLevelParam.back().first > mSubGroupSize; mMaxBVHLevel++)
-	{
-		pushConstants = {mLevelParam.back().first, pushConstants.nextOffset, pushConstants.nextOffset + mLevelParam.back().first };
-					
+		cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("bvh"));
 		cmd.pushConstants(bvhLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
 		barrier(cmd);
-		cmd.dispatch(groupsCount(pushConstants.count), 1, 1);
+		cmd.dispatch(groupsCount(mLightsCount), 1, 1);
+
+		mLevelParam.emplace_back(mLightsCount, 0);
+		mLevelParam.emplace_back(createdNodes(mLightsCount), pushConstants.nextOffset);
+	
+		for ( ;mLevelParam.back().first > mSubGroupSize; mMaxBVHLevel++)
+		{
+			pushConstants = {mLevelParam.back().first, pushConstants.nextOffset, pushConstants.nextOffset + mLevelParam.back().first };
+					
+			cmd.pushConstants(bvhLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), &pushConstants);
+			barrier(cmd);
+			cmd.dispatch(groupsCount(pushConstants.count), 1, 1);
 		
-		mLevelParam.emplace_back(createdNodes(mLevelParam.back().first), pushConstants.nextOffset);
+			mLevelParam.emplace_back(createdNodes(mLevelParam.back().first), pushConstants.nextOffset);
+		}
 	}
 
 	// release ownership
@@ -1815,18 +3406,35 @@ mResource.descriptorSet.get("lightculling_front")
 	
 	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eByRegion, nullptr, before, nullptr);
 
-	cmd.fillBuffer(*mClusteredBuffer.handle, 0, VK_WHOLE_SIZE, 0);
+	// pool of light indices follows counters and tile headers, see lightculling_tiled.comp
+	constexpr vk::DeviceSize tileListsHeaderSize = 4 * sizeof(uint32_t) + 65'536 * 2 * sizeof(uint32_t);
+	std::array<uint32_t, 2> pushConstants = { mLightsCount, static_cast<uint32_t>((mLightsOutSize - tileListsHeaderSize) / sizeof(uint32_t)) };
+
+	vk::MemoryBarrier fillBarrier;
+	fillBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	fillBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+	vk::MemoryBarrier readbackBarrier;
+	readbackBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	readbackBarrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+	// pool counter, overflow counter and longest list
+	cmd.fillBuffer(*mLightsBuffers.handle, mLightsOutOffset, 3 * sizeof(uint32_t), 0);
 	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mResource.pipelineLayout.get("lightculling_tiled"), 0, descriptorSets, nullptr);
 	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("lightculling_tiled"));
-	cmd.pushConstants(mResource.pipelineLayout.get("lightculling_tiled"), vk::ShaderStageFlagBits::eCompute, 0, 4, &mLightsCount);
-	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eByRegion , nullptr, nullptr, nullptr); 
-	cmd.dispatch(mTileCount.x, mTileCount.y, 1);
+	cmd.pushConstants(mResource.pipelineLayout.get("lightculling_tiled"), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), pushConstants.data());
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eByRegion, fillBarrier, nullptr, nullptr); 
+	cmd.dispatch((mRenderExtent.width - 1) / mCurrentTileSize + 1, (mRenderExtent.height - 1) / mCurrentTileSize + 1, 1); // tiles of render extent, frustums span workgroup grid
+
+	// light references, overflow and longest list are read on host next frame
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eByRegion, readbackBarrier, nullptr, nullptr);
+	mUtility.recordCopyBuffer(cmd, *mLightsBuffers.handle, *mTiledStatsBuffer.handle, 3 * sizeof(uint32_t), mLightsOutOffset);
 	cmd.end();
 
 	
 	std::vector<vk::PipelineStageFlags> waitStages = {vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe};
 	std::vector<vk::Semaphore> waitSemaphores = { 
-		mResource.semaphore.get("gBufferFinished"), 
+		mResource.semaphore.get(mDepthPrepass ? "depthPrepassFinished" : "gBufferFinished"), 
 		mResource.semaphore.get("lightCopyFinished")
 	};
 
@@ -1846,33 +3454,27 @@ void Renderer::submitTiledCompositionCmds(size_t imageIndex)
 {
 	auto& cmd = mResource.cmd.get("primaryComposition", imageIndex);
 
-	vk::RenderPassBeginInfo renderpassInfo;
-	renderpassInfo.renderPass = *mCompositionRenderpass;
-	renderpassInfo.framebuffer = *mSwapchainFramebuffers[imageIndex];
-	renderpassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
-	renderpassInfo.renderArea.extent = mSwapchainExtent;
-	
-	std::array<vk::DescriptorSet, 2> descriptorSets = {
+	std::vector<vk::DescriptorSet> descriptorSets = {
 		mResource.descriptorSet.get("camera"),
 		mResource.descriptorSet.get("composition_front")
 	};
-	
-	std::array<vk::ClearValue, 1> clearValues;
-	clearValues[0].color.setFloat32({ 1.0f, 0.8f, 0.4f, 1.0f });
 
-	renderpassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-	renderpassInfo.pClearValues = clearValues.data();
+	if (mCompositionMode == CompositionMode::subpass)
+		descriptorSets.emplace_back(mResource.descriptorSet.get("gbuffer_input"));
 
 	cmd.begin(vk::CommandBufferBeginInfo{});
 	BaseApp::getInstance().getUI().copyDrawData(cmd);
+	writeCompositionTimestamp(cmd, true);
 
-	cmd.beginRenderPass(renderpassInfo, vk::SubpassContents::eInline);
+	recordDiffusePass(cmd, "composition_tiled", descriptorSets);
+	beginCompositionRenderPass(cmd, imageIndex);
 
 	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("composition_tiled"));
 	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get("composition_tiled"), 0, descriptorSets, nullptr);
 	cmd.draw(4, 1, 0, 0);
 
-	cmd.nextSubpass(vk::SubpassContents::eInline);
+	writeCompositionTimestamp(cmd, false);
+	nextCompositionSubpass(cmd, imageIndex);
 	BaseApp::getInstance().getUI().recordCommandBuffer(cmd);
 	cmd.endRenderPass();
 
@@ -1890,11 +3492,23 @@ void Renderer::submitTiledCompositionCmds(size_t imageIndex)
 
 
 	vk::PipelineStageFlags waitStages = vk::PipelineStageFlagBits::eFragmentShader;
+	if (mCompositionMode == CompositionMode::subpass) // G-buffer subpass is ordered after prepass through light culling
+		waitStages |= vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+
+	std::vector<vk::PipelineStageFlags> waitStageMasks = { waitStages };
+	std::vector<vk::Semaphore> waitSemaphores = { mResource.semaphore.get("lightCullingFinished") };
+
+	// G-buffer shading overlapped light culling after separate depth prepass
+	if (mDepthPrepass)
+	{
+		waitStageMasks.emplace_back(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader);
+		waitSemaphores.emplace_back(mResource.semaphore.get("gBufferFinished"));
+	}
 
 	vk::SubmitInfo submitInfo;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &mResource.semaphore.get("lightCullingFinished");
-	submitInfo.pWaitDstStageMask = &waitStages;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStageMasks.data();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &cmd;
 	submitInfo.signalSemaphoreCount = 1;
@@ -1903,29 +3517,155 @@ void Renderer::submitTiledCompositionCmds(size_t imageIndex)
 	mContext.getGeneralQueue().submit(submitInfo, nullptr);
 }
 
-void Renderer::submitDeferredCompositionCmds(size_t imageIndex)
+void Renderer::submitZBinLightCullingCmds(size_t imageIndex)
+{
+	auto& cmd = mResource.cmd.get("lightculling_zbin");
+
+	std::array<vk::DescriptorSet, 3> descriptorSets{
+		mResource.descriptorSet.get("camera"),
+		mResource.descriptorSet.get(mLightBufferSwapUsed),
+		mResource.descriptorSet.get("zbin")
+	};
+
+	// masks follow light and tile count
+	updateZBinBuffer();
+	const uint32_t tileCount = mTileCount.x * mTileCount.y;
+
+	std::array<uint32_t, 2> pushConstants = { mZBinLightCount, mZBinWordsPerTile };
+
+	vk::BufferMemoryBarrier acquisitionBarrier;
+	acquisitionBarrier.buffer = *mLightsBuffers.handle;
+	acquisitionBarrier.size = VK_WHOLE_SIZE;
+	acquisitionBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	acquisitionBarrier.srcQueueFamilyIndex = mContext.getQueueFamilyIndices().computeFamily;
+	acquisitionBarrier.dstQueueFamilyIndex = mContext.getQueueFamilyIndices().generalFamily;
+
+	vk::MemoryBarrier fillBarrier;
+	fillBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	fillBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+	cmd.begin(vk::CommandBufferBeginInfo{});
+	// acquire ownership
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eByRegion, nullptr, acquisitionBarrier, nullptr);
+
+	// empty bins have min above max, references counter follows max
+	cmd.fillBuffer(*mZBinBuffer.handle, 0, 1'024 * sizeof(uint32_t), ~0u);
+	cmd.fillBuffer(*mZBinBuffer.handle, 1'024 * sizeof(uint32_t), (1'024 + 1) * sizeof(uint32_t), 0);
+	cmd.fillBuffer(*mZBinBuffer.handle, mZBinMaskOffset, static_cast<vk::DeviceSize>(tileCount) * mZBinWordsPerTile * sizeof(uint32_t), 0);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlagBits::eByRegion, fillBarrier, nullptr, nullptr);
+
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("zbin"));
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mResource.pipelineLayout.get("zbin"), 0, descriptorSets, nullptr);
+	cmd.pushConstants(mResource.pipelineLayout.get("zbin"), vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), pushConstants.data());
+	cmd.dispatch((mZBinLightCount - 1) / 64 + 1, 1, 1);
+
+	// light references are read on host next frame
+	vk::MemoryBarrier readbackBarrier;
+	readbackBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	readbackBarrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eByRegion, readbackBarrier, nullptr, nullptr);
+	mUtility.recordCopyBuffer(cmd, *mZBinBuffer.handle, *mZBinStatsBuffer.handle, sizeof(uint32_t), 2 * 1'024 * sizeof(uint32_t));
+	cmd.end();
+
+	std::vector<vk::PipelineStageFlags> waitStages = {vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe};
+	std::vector<vk::Semaphore> waitSemaphores = { 
+		mResource.semaphore.get(mDepthPrepass ? "depthPrepassFinished" : "gBufferFinished"), 
+		mResource.semaphore.get("lightSortingFinished")
+	};
+
+	vk::SubmitInfo submitInfo;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &mResource.semaphore.get("lightCullingFinished");
+
+	mContext.getGeneralQueue().submit(submitInfo, nullptr);
+}
+
+void Renderer::submitZBinCompositionCmds(size_t imageIndex)
 {
 	auto& cmd = mResource.cmd.get("primaryComposition", imageIndex);
 
-	vk::RenderPassBeginInfo renderpassInfo;
-	renderpassInfo.renderPass = *mCompositionRenderpass;
-	renderpassInfo.framebuffer = *mSwapchainFramebuffers[imageIndex];
-	renderpassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
-	renderpassInfo.renderArea.extent = mSwapchainExtent;
+	std::vector<vk::DescriptorSet> descriptorSets = {
+		mResource.descriptorSet.get("camera"),
+		mResource.descriptorSet.get(mLightBufferSwapUsed == "lightculling_front" ? "composition_front" : "composition_back"),
+		mResource.descriptorSet.get("gbuffer_input"),
+		mResource.descriptorSet.get("zbin")
+	};
+
+	cmd.begin(vk::CommandBufferBeginInfo{});
+	BaseApp::getInstance().getUI().copyDrawData(cmd);
+	writeCompositionTimestamp(cmd, true);
+
+	recordDiffusePass(cmd, "composition_zbin", descriptorSets, &mZBinWordsPerTile);
+	beginCompositionRenderPass(cmd, imageIndex);
+
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("composition_zbin"));
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get("composition_zbin"), 0, descriptorSets, nullptr);
+	cmd.pushConstants(mResource.pipelineLayout.get("composition_zbin"), vk::ShaderStageFlagBits::eFragment, 0, 4, &mZBinWordsPerTile);
+	cmd.draw(4, 1, 0, 0);
+
+	writeCompositionTimestamp(cmd, false);
+	nextCompositionSubpass(cmd, imageIndex);
+	BaseApp::getInstance().getUI().recordCommandBuffer(cmd);
+	cmd.endRenderPass();
+
+	// release ownership
+	vk::BufferMemoryBarrier after;
+	after.buffer = *mLightsBuffers.handle;
+	after.size = VK_WHOLE_SIZE;
+	after.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+	after.srcQueueFamilyIndex = mContext.getQueueFamilyIndices().generalFamily;
+	after.dstQueueFamilyIndex = mContext.getQueueFamilyIndices().computeFamily;
 	
-	std::array<vk::DescriptorSet, 2> descriptorSets = {
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlagBits::eByRegion, nullptr, after, nullptr);
+	cmd.end();
+
+	vk::PipelineStageFlags waitStages = vk::PipelineStageFlagBits::eFragmentShader;
+	if (mCompositionMode == CompositionMode::subpass) // G-buffer subpass is ordered after prepass through light culling
+		waitStages |= vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+
+	std::vector<vk::PipelineStageFlags> waitStageMasks = { waitStages };
+	std::vector<vk::Semaphore> waitSemaphores = { mResource.semaphore.get("lightCullingFinished") };
+
+	// G-buffer shading overlapped light culling after separate depth prepass
+	if (mDepthPrepass)
+	{
+		waitStageMasks.emplace_back(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader);
+		waitSemaphores.emplace_back(mResource.semaphore.get("gBufferFinished"));
+	}
+
+	vk::SubmitInfo submitInfo;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStageMasks.data();
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &mResource.semaphore.get("renderFinished", mCurrentFrame);
+
+	mContext.getGeneralQueue().submit(submitInfo, nullptr);
+}
+
+void Renderer::submitDeferredCompositionCmds(size_t imageIndex)
+{
+	auto& cmd = mResource.cmd.get("primaryComposition", imageIndex);
+
+	std::vector<vk::DescriptorSet> descriptorSets = {
 		mResource.descriptorSet.get("camera"),
 		mResource.descriptorSet.get("composition_front")
 	};
-	
-	std::array<vk::ClearValue, 1> clearValues;
-	clearValues[0].color.setFloat32({ 1.0f, 0.8f, 0.4f, 1.0f });
 
-	renderpassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-	renderpassInfo.pClearValues = clearValues.data();
+	if (mCompositionMode == CompositionMode::subpass)
+		descriptorSets.emplace_back(mResource.descriptorSet.get("gbuffer_input"));
 
 	cmd.begin(vk::CommandBufferBeginInfo{});
 	BaseApp::getInstance().getUI().copyDrawData(cmd);
+	writeCompositionTimestamp(cmd, true);
 
 	// acquire ownership
 	vk::BufferMemoryBarrier before;
@@ -1935,15 +3675,29 @@ void Renderer::submitDeferredCompositionCmds(size_t imageIndex)
 	before.srcQueueFamilyIndex = mContext.getQueueFamilyIndices().computeFamily;
 	before.dstQueueFamilyIndex = mContext.getQueueFamilyIndices().generalFamily;
 	
-	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlagBits::eByRegion, nullptr, before, nullptr);
-	cmd.beginRenderPass(renderpassInfo, vk::SubpassContents::eInline);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlagBits::eByRegion, nullptr, before, nullptr);
+
+	// light volumes add lights over ambient only pass
+	uint32_t lightCount = mLightVolumes ? 0 : mLightsCount;
+
+	recordDiffusePass(cmd, "composition_deferred", descriptorSets, &lightCount);
+	beginCompositionRenderPass(cmd, imageIndex);
 
 	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("composition_deferred"));
 	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get("composition_deferred"), 0, descriptorSets, nullptr);
-	cmd.pushConstants(mResource.pipelineLayout.get("composition_deferred"), vk::ShaderStageFlagBits::eFragment, 0, 4, &mLightsCount);
+	cmd.pushConstants(mResource.pipelineLayout.get("composition_deferred"), vk::ShaderStageFlagBits::eFragment, 0, 4, &lightCount);
 	cmd.draw(4, 1, 0, 0);
 
-	cmd.nextSubpass(vk::SubpassContents::eInline);
+	// icosahedron per light, 20 faces without index buffer
+	if (mLightVolumes)
+	{
+		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("light_volume"));
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get("light_volume"), 0, descriptorSets, nullptr);
+		cmd.draw(60, mLightsCount, 0, 0);
+	}
+
+	writeCompositionTimestamp(cmd, false);
+	nextCompositionSubpass(cmd, imageIndex);
 	BaseApp::getInstance().getUI().recordCommandBuffer(cmd);
 	cmd.endRenderPass();
 
@@ -1965,6 +3719,13 @@ void Renderer::submitDeferredCompositionCmds(size_t imageIndex)
 		mResource.semaphore.get("lightCopyFinished")
 	};
 
+	// no light culling consumed the depth prepass
+	if (mDepthPrepass)
+	{
+		waitStages.emplace_back(vk::PipelineStageFlagBits::eTopOfPipe);
+		waitSemaphores.emplace_back(mResource.semaphore.get("depthPrepassFinished"));
+	}
+
 	vk::SubmitInfo submitInfo;
 	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
 	submitInfo.pWaitSemaphores = waitSemaphores.data();
@@ -1979,6 +3740,18 @@ void Renderer::submitDeferredCompositionCmds(size_t imageIndex)
 
 void Renderer::submitGbufferCmds()
 {
+	// depth prepass goes first, light culling waits only for it
+	if (mDepthPrepass)
+	{
+		vk::SubmitInfo prepassInfo;
+		prepassInfo.commandBufferCount = 1;
+		prepassInfo.pCommandBuffers = &mResource.cmd.get("depthPrepass");
+		prepassInfo.signalSemaphoreCount = 1;
+		prepassInfo.pSignalSemaphores = &mResource.semaphore.get("depthPrepassFinished");
+
+		mContext.getGeneralQueue().submit(prepassInfo, nullptr);
+	}
+
 	vk::PipelineStageFlags waitStages = vk::PipelineStageFlagBits::eColorAttachmentOutput;
 
 	vk::SubmitInfo submitInfo;
@@ -2023,7 +3796,14 @@ void Renderer::submitDebugCmds(size_t imageIndex)
 	std::vector<vk::PipelineStageFlags> waitStages = { vk::PipelineStageFlagBits::eFragmentShader };
 	std::vector<vk::Semaphore> semaphores = { mResource.semaphore.get("gBufferFinished") };
 
-	if (BaseApp::getInstance().getUI().mContext.cullingMethod == CullingMethod::clustered)
+	// no light culling consumed the depth prepass
+	if (mDepthPrepass)
+	{
+		waitStages.emplace_back(vk::PipelineStageFlagBits::eTopOfPipe);
+		semaphores.emplace_back(mResource.semaphore.get("depthPrepassFinished"));
+	}
+
+	if (sortsLights(BaseApp::getInstance().getUI().mContext.cullingMethod))
 	{
 		waitStages.emplace_back(vk::PipelineStageFlagBits::eTopOfPipe);
 		semaphores.emplace_back(mResource.semaphore.get("lightSortingFinished"));
@@ -2041,20 +3821,290 @@ void Renderer::submitDebugCmds(size_t imageIndex)
 	mContext.getGeneralQueue().submit(submitInfo, nullptr);
 }
 
+void Renderer::recordMeshletCulling(vk::CommandBuffer cmd)
+{
+	// cull meshlets of selected lods, culled meshlets get zero instance count
+	const auto& model = mScene.getModel();
+	if (!BaseApp::getInstance().getUI().mContext.meshletCulling || model.getMeshletCount() == 0 || mVisibilityBuffer)
+		return;
+
+	auto meshletCount = model.getMeshletCount();
+	auto cullingLayout = mResource.pipelineLayout.get("meshlet_culling");
+
+	std::array<vk::DescriptorSet, 3> cullingSets = {
+		mResource.descriptorSet.get("camera"),
+		mResource.descriptorSet.get("model"),
+		mResource.descriptorSet.get("meshlets")
+	};
+
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, mResource.pipeline.get("meshlet_culling"));
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cullingLayout, 0, cullingSets, nullptr);
+	cmd.pushConstants(cullingLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &meshletCount);
+	cmd.dispatch((meshletCount - 1) / 64 + 1, 1, 1);
+
+	vk::MemoryBarrier barrier;
+	barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+	barrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead;
+
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect, {}, barrier, nullptr, nullptr);
+}
+
+void Renderer::recordGeometryDraws(vk::CommandBuffer cmd, const std::string& pipeline, bool positionsOnly)
+{
+	// whole scene is drawn by single multi draw indirect call, part index is instance index
+	const auto& model = mScene.getModel();
+	bool meshletCulling = BaseApp::getInstance().getUI().mContext.meshletCulling && model.getMeshletCount() > 0 && !mVisibilityBuffer;
+
+	std::array<vk::DescriptorSet, 3> descriptorSets = {
+		mResource.descriptorSet.get("camera"),
+		mResource.descriptorSet.get("model"),
+		mResource.descriptorSet.get("material")
+	};
+
+	auto pipelineLayout = mResource.pipelineLayout.get("gbuffers");
+
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get(model.hasPackedVertices() ? pipeline + "_packed" : pipeline));
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSets, nullptr);
+
+	auto vertexSection = positionsOnly ? model.getPositionBufferSection() : model.getVertexBufferSection();
+	auto indexSection = model.getIndexBufferSection();
+	auto indirectSection = meshletCulling ? model.getMeshletCommandSection() : model.getIndirectBufferSection();
+	auto drawCount = meshletCulling ? model.getMeshletCount() : static_cast<uint32_t>(model.getMeshParts().size());
+
+	cmd.bindVertexBuffers(0, vertexSection.handle, vertexSection.offset);
+	cmd.bindIndexBuffer(indexSection.handle, indexSection.offset, vk::IndexType::eUint32);
+
+	if (mContext.getEnabledFeatures().multiDrawIndirect)
+	{
+		uint32_t maxDrawCount = mContext.getPhysicalDevice().getProperties().limits.maxDrawIndirectCount;
+		for (uint32_t first = 0; first < drawCount; first += maxDrawCount)
+		{
+			auto count = std::min(maxDrawCount, drawCount - first);
+			cmd.drawIndexedIndirect(indirectSection.handle, indirectSection.offset + first * sizeof(vk::DrawIndexedIndirectCommand), count, sizeof(vk::DrawIndexedIndirectCommand));
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < drawCount; i++)
+			cmd.drawIndexedIndirect(indirectSection.handle, indirectSection.offset + i * sizeof(vk::DrawIndexedIndirectCommand), 1, sizeof(vk::DrawIndexedIndirectCommand));
+	}
+}
+
+void Renderer::beginCompositionRenderPass(vk::CommandBuffer cmd, size_t imageIndex)
+{
+	bool merged = mCompositionMode == CompositionMode::subpass;
+
+	std::vector<vk::ClearValue> clearValues(merged ? 5 : 1);
+	for (auto& value : clearValues)
+		value.color.setFloat32({ 0.0f, 0.0f, 0.0f, 0.0f });
+	clearValues[0].color.setFloat32({ 1.0f, 0.8f, 0.4f, 1.0f });
+
+	vk::RenderPassBeginInfo renderpassInfo;
+	renderpassInfo.renderPass = merged ? *mMergedRenderpass : *mCompositionRenderpass;
+	renderpassInfo.framebuffer = merged ? *mMergedFramebuffers[imageIndex] : *mSwapchainFramebuffers[imageIndex];
+	renderpassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+	renderpassInfo.renderArea.extent = mSwapchainExtent;
+	renderpassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderpassInfo.pClearValues = clearValues.data();
+
+	// dynamic resolution composes scene color, swapchain pass begins with upscale in nextCompositionSubpass
+	if (mDynamicResolution)
+	{
+		renderpassInfo.renderPass = *mSceneRenderpass;
+		renderpassInfo.framebuffer = *mSceneFramebuffer;
+		renderpassInfo.renderArea.extent = mRenderExtent;
+	}
+
+	cmd.beginRenderPass(renderpassInfo, vk::SubpassContents::eInline);
+	setRenderViewport(cmd, mRenderExtent);
+
+	// G-buffer subpass, depth was written by prepass
+	if (merged)
+	{
+		recordGeometryDraws(cmd, "gbuffers");
+		cmd.nextSubpass(vk::SubpassContents::eInline);
+	}
+}
+
+void Renderer::recordDiffusePass(vk::CommandBuffer cmd, const std::string& pipeline, const std::vector<vk::DescriptorSet>& descriptorSets, const uint32_t* pushConstant)
+{
+	if (mDiffuseScale == 1)
+		return;
+
+	vk::RenderPassBeginInfo renderpassInfo;
+	renderpassInfo.renderPass = *mDiffuseRenderpass;
+	renderpassInfo.framebuffer = *mDiffuseFramebuffer;
+	renderpassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+	renderpassInfo.renderArea.extent = getDiffuseExtent(mRenderExtent);
+
+	cmd.beginRenderPass(renderpassInfo, vk::SubpassContents::eInline);
+	setRenderViewport(cmd, renderpassInfo.renderArea.extent);
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get(pipeline + "_diffuse"));
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get(pipeline), 0, descriptorSets, nullptr);
+
+	if (pushConstant)
+		cmd.pushConstants(mResource.pipelineLayout.get(pipeline), vk::ShaderStageFlagBits::eFragment, 0, 4, pushConstant);
+
+	cmd.draw(4, 1, 0, 0);
+	cmd.endRenderPass();
+
+	// split of composition time in profiler
+	if (mTimestampQueryPool)
+		cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *mTimestampQueryPool, 2);
+}
+
+void Renderer::nextCompositionSubpass(vk::CommandBuffer cmd, size_t imageIndex)
+{
+	if (!mDynamicResolution)
+	{
+		cmd.nextSubpass(vk::SubpassContents::eInline);
+		return;
+	}
+
+	cmd.endRenderPass();
+
+	vk::ClearValue clearValue;
+	clearValue.color.setFloat32({ 1.0f, 0.8f, 0.4f, 1.0f });
+
+	vk::RenderPassBeginInfo renderpassInfo;
+	renderpassInfo.renderPass = *mCompositionRenderpass;
+	renderpassInfo.framebuffer = *mSwapchainFramebuffers[imageIndex];
+	renderpassInfo.renderArea.offset = vk::Offset2D{ 0, 0 };
+	renderpassInfo.renderArea.extent = mSwapchainExtent;
+	renderpassInfo.clearValueCount = 1;
+	renderpassInfo.pClearValues = &clearValue;
+
+	glm::vec2 renderSize(mRenderExtent.width, mRenderExtent.height);
+
+	cmd.beginRenderPass(renderpassInfo, vk::SubpassContents::eInline);
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, mResource.pipeline.get("upscale"));
+	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mResource.pipelineLayout.get("upscale"), 0, mResource.descriptorSet.get("scene_color"), nullptr);
+	cmd.pushConstants(mResource.pipelineLayout.get("upscale"), vk::ShaderStageFlagBits::eFragment, 0, sizeof(renderSize), &renderSize);
+	cmd.draw(4, 1, 0, 0);
+	cmd.nextSubpass(vk::SubpassContents::eInline);
+}
+
+void Renderer::setRenderViewport(vk::CommandBuffer cmd, vk::Extent2D extent)
+{
+	vk::Viewport viewport;
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	cmd.setViewport(0, viewport);
+	cmd.setScissor(0, vk::Rect2D{ { 0, 0 }, extent });
+}
+
+void Renderer::setRenderScale(float scale)
+{
+	mRenderScale = scale;
+	mRenderExtent.width = std::max(static_cast<uint32_t>(mSwapchainExtent.width * scale), 1u);
+	mRenderExtent.height = std::max(static_cast<uint32_t>(mSwapchainExtent.height * scale), 1u);
+}
+
+void Renderer::updateRenderScale()
+{
+	const auto& context = BaseApp::getInstance().getUI().mContext;
+
+	// debug views sample G-buffer over whole swapchain
+	auto debugState = BaseApp::getInstance().getUI().getDebugIndex();
+	bool debugView = debugState != DebugStates::disabled && debugState != DebugStates::lightCount;
+
+	float scale = 1.0f;
+	if (mDynamicResolution && !debugView)
+	{
+		scale = mRenderScale;
+
+		// cost follows pixel count, so scale goes with square root of time ratio, in 5% steps with dead band
+		if (++mFramesSinceScaling > 30 && mFrameTime > 0.0f)
+		{
+			float ratio = context.frameTimeTarget / mFrameTime;
+			if (ratio < 0.95f || ratio > 1.05f)
+				scale = std::clamp(std::round(mRenderScale * std::sqrt(ratio) * 20.0f) / 20.0f, 0.5f, 1.0f);
+		}
+	}
+
+	if (scale == mRenderScale)
+		return;
+
+	setRenderScale(scale);
+	mFramesSinceScaling = 0;
+	mFrameTime = 0.0f; // restarts smoothing at new scale
+
+	// attachments keep their size, only static command buffers record new viewport
+	mContext.getDevice().waitIdle();
+	createGraphicsCommandBuffers();
+}
+
+glm::uvec2 Renderer::getVisibilityBits() const
+{
+	const auto& parts = mScene.getModel().getMeshParts();
+
+	uint32_t maxTriangles = 0;
+	for (const auto& part : parts)
+		maxTriangles = std::max(maxTriangles, part.indexCount / 3);
+
+	auto bitCount = [](uint32_t value) { uint32_t bits = 0; while (value >> bits) bits++; return bits; };
+	return { std::max(bitCount(static_cast<uint32_t>(parts.size()) - 1), 1u), bitCount(maxTriangles) };
+}
+
+bool Renderer::useVisibilityBuffer() const
+{
+	const auto& context = BaseApp::getInstance().getUI().mContext;
+	if (!context.visibilityBuffer || !mVisibilityBufferSupported || context.compositionMode == CompositionMode::subpass)
+		return false;
+
+	// all ones is cleared background, scenes with more triangles fall back to G-buffer
+	auto bits = getVisibilityBits();
+	return bits.x + bits.y < 32;
+}
+
 void Renderer::setTileCount()
 {
 	int width, height;
     glfwGetFramebufferSize(mContext.getWindow(), &width, &height);
 	mTileCount = {(width - 1) / mCurrentTileSize + 1, (height - 1) / mCurrentTileSize + 1};
+
+	// cluster key is tile x, tile y and depth slice, page table keeps ~2k pages
+	auto bitCount = [](uint32_t count)
+	{
+		uint32_t bits = 0;
+		while ((1u << bits) < count)
+			bits++;
+
+		return bits;
+	};
+
+	mClusterKeyBits = { bitCount(mTileCount.x), bitCount(mTileCount.y) };
+	uint32_t keyBits = mClusterKeyBits.x + mClusterKeyBits.y + bitCount(mDepthSlices);
+
+	mPageSizePower = std::clamp(keyBits, 21u, 25u) - 11; // 1k to 16k entries per page, compaction takes 1k per pass
+	mPageTableEntries = 1u << (std::max(keyBits, mPageSizePower) - mPageSizePower);
 }
 
 GBuffer Renderer::generateGBuffer()
 {
 	GBuffer buffer;
 
+	// merged pass keeps G-buffer in tile memory, it is only read as input attachment
+	auto usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eSampled;
+	auto memoryFlags = vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+	if (mCompositionMode == CompositionMode::subpass)
+	{
+		usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eTransientAttachment;
+
+		// preferred only, createImage keeps device local memory when attachment can't be lazily allocated
+		memoryFlags |= vk::MemoryPropertyFlagBits::eLazilyAllocated;
+	}
+
 	// depth buffer
 	{
-		auto formatCandidates = { vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint };
+		// reversed depth needs float format, fixed point one would lose precision gained by it
+		std::vector<vk::Format> formatCandidates = { vk::Format::eD32Sfloat };
+		if (!mReversedDepth)
+			formatCandidates.insert(formatCandidates.end(), { vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint });
 		auto depthFormat = mUtility.findSupportedFormat(formatCandidates, vk::ImageTiling::eOptimal, vk::FormatFeatureFlagBits::eDepthStencilAttachment);
 
 		// for depth pre pass and output as texture
@@ -2062,21 +4112,22 @@ GBuffer Renderer::generateGBuffer()
 			mSwapchainExtent.width, mSwapchainExtent.height,
 			depthFormat,
 			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
+			vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eInputAttachment,
 			vk::MemoryPropertyFlagBits::eDeviceLocal
 		);
 
 		buffer.depth.view = mUtility.createImageView(*buffer.depth.handle, depthFormat, vk::ImageAspectFlagBits::eDepth);
 	}
 
-	// position
+	// position, not needed when reconstructed from depth
+	if (!mReconstructPosition)
 	{
 		buffer.position = mUtility.createImage(
 			mSwapchainExtent.width, mSwapchainExtent.height,
 			vk::Format::eR16G16B16A16Sfloat,
 			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
-			vk::MemoryPropertyFlagBits::eDeviceLocal
+			usage,
+			memoryFlags
 		);
 
 		buffer.position.view = mUtility.createImageView(*buffer.position.handle, buffer.position.format, vk::ImageAspectFlagBits::eColor);
@@ -2088,8 +4139,8 @@ GBuffer Renderer::generateGBuffer()
 			mSwapchainExtent.width, mSwapchainExtent.height,
 			vk::Format::eR8G8B8A8Unorm,
 			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
-			vk::MemoryPropertyFlagBits::eDeviceLocal
+			usage,
+			memoryFlags
 		);
 
 		buffer.color.view = mUtility.createImageView(*buffer.color.handle, buffer.color.format, vk::ImageAspectFlagBits::eColor);
@@ -2101,12 +4152,37 @@ GBuffer Renderer::generateGBuffer()
 			mSwapchainExtent.width, mSwapchainExtent.height,
 			vk::Format::eR16G16Sfloat,
 			vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
-			vk::MemoryPropertyFlagBits::eDeviceLocal
+			usage,
+			memoryFlags
 		);
 
 		buffer.normal.view = mUtility.createImageView(*buffer.normal.handle, buffer.normal.format, vk::ImageAspectFlagBits::eColor);
 	}
 
+	// triangle IDs, only read by resolve subpass
+	if (mVisibilityBuffer)
+	{
+		buffer.visibility = mUtility.createImage(
+			mSwapchainExtent.width, mSwapchainExtent.height,
+			vk::Format::eR32Uint,
+			vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eTransientAttachment,
+			vk::MemoryPropertyFlagBits::eDeviceLocal
+		);
+
+		buffer.visibility.view = mUtility.createImageView(*buffer.visibility.handle, buffer.visibility.format, vk::ImageAspectFlagBits::eColor);
+	}
+
 	return buffer;
 }
+
+vk::Extent2D Renderer::getDiffuseExtent(vk::Extent2D extent) const
+{
+	return { (extent.width - 1) / mDiffuseScale + 1, (extent.height - 1) / mDiffuseScale + 1 };
+}
+
+vk::ImageLayout Renderer::getSampledDepthLayout() const
+{
+	// separate prepass leaves depth read only attached for G-buffer pass, while it is sampled by light culling
+	return mDepthPrepass ? vk::ImageLayout::eDepthStencilReadOnlyOptimal : vk::ImageLayout::eShaderReadOnlyOptimal;
+}
@@ -16,6 +16,7 @@
 class Scene;
 struct GLFWwindow;
 struct PointLight;
+enum class CompositionMode : int;
 
 class Renderer
 {
@@ -35,6 +36,8 @@ private:
 	void createSwapChain();
 	void createSwapChainImageViews();
 	void createRenderPasses();
+	void createGBufferRenderPass();
+	void createMergedRenderPass();
 	void createFrameBuffers();
 	void createDescriptorSetLayouts();
 	void createPipelineCache();
@@ -49,11 +52,14 @@ private:
 	void updateDescriptorSets();
 	void createGraphicsCommandBuffers();
 	void createSyncPrimitives();
+	void createQueryPools();
 
 	void createComputePipeline();
 	void createComputeCommandBuffer();
 
 	void updateUniformBuffers();
+	glm::vec2 getClusterDepthRange(const glm::mat4& view) const;
+	void readQueryResults();
 	void drawFrame();
 
 	void submitClusteredLightCullingCmds(size_t imageIndex);
@@ -61,12 +67,30 @@ private:
 	void submitBVHCreationCmds(size_t imageIndex);
 	void submitTiledLightCullingCmds(size_t imageIndex);
 	void submitTiledCompositionCmds(size_t imageIndex);
+	void submitZBinLightCullingCmds(size_t imageIndex);
+	void submitZBinCompositionCmds(size_t imageIndex);
 	void submitDeferredCompositionCmds(size_t imageIndex);
 	void submitGbufferCmds();
 	void submitDebugCmds(size_t imageIndex);
+
+	void recordGeometryDraws(vk::CommandBuffer cmd, const std::string& pipeline, bool positionsOnly = false);
+	void recordMeshletCulling(vk::CommandBuffer cmd);
+	void writeCompositionTimestamp(vk::CommandBuffer cmd, bool begin);
+	void beginCompositionRenderPass(vk::CommandBuffer cmd, size_t imageIndex);
+	void recordDiffusePass(vk::CommandBuffer cmd, const std::string& pipeline, const std::vector<vk::DescriptorSet>& descriptorSets, const uint32_t* pushConstant = nullptr);
+	void nextCompositionSubpass(vk::CommandBuffer cmd, size_t imageIndex);
+	void setRenderViewport(vk::CommandBuffer cmd, vk::Extent2D extent);
+	void setRenderScale(float scale);
+	void updateRenderScale();
 	
 	void setTileCount();
+	void updateZBinBuffer();
+	void writeZBinDescriptorSet();
+	glm::uvec2 getVisibilityBits() const; // part and primitive bits of triangle ID
+	bool useVisibilityBuffer() const;
 	GBuffer generateGBuffer();
+	vk::ImageLayout getSampledDepthLayout() const;
+	vk::Extent2D getDiffuseExtent(vk::Extent2D extent) const;
 
 private:
 	Context mContext;
@@ -81,6 +105,8 @@ private:
 
 	vk::Format mSwapchainImageFormat;
 	vk::Extent2D mSwapchainExtent;
+	vk::Extent2D mRenderExtent; // area of full size attachments covered by G-buffer and lighting
+	float mRenderScale = 1.0f;
 	size_t mCurrentFrame = 0;
 
 	vk::UniquePipelineCache mPipelineCache;
@@ -90,10 +116,37 @@ private:
 	vk::UniqueSampler mSampler;
 	vk::UniqueRenderPass mGBufferRenderpass;
 	vk::UniqueFramebuffer mGBufferFramebuffer;
+	bool mReconstructPosition = false; // position target is not rendered, composition reconstructs it from depth
+	bool mVisibilityBuffer = false; // triangle IDs are rasterized, G-buffer is resolved from them in second subpass
+	bool mDepthPrepass = false; // separate depth pass, G-buffer pass tests equal and keeps depth read only
+	bool mReversedDepth = false; // D32 depth, greater passes and clear is zero
 
 	// composition
 	vk::UniqueRenderPass mCompositionRenderpass;
 	std::vector<vk::UniqueFramebuffer> mSwapchainFramebuffers;
+	bool mLightVolumes = false; // G-buffer depth is attached read only, light volumes are depth tested against it
+	ImageParameters mComposedImage; // written by compute composition, copied to swapchain by present pass
+
+	// reduced resolution diffuse lighting, irradiance with view depth and octahedral normal of shaded samples
+	uint32_t mDiffuseScale = 1; // pixels per side of block sharing one diffuse sample
+	ImageParameters mDiffuseImage;
+	ImageParameters mDiffuseNormal;
+	vk::UniqueRenderPass mDiffuseRenderpass;
+	vk::UniqueFramebuffer mDiffuseFramebuffer;
+
+	// dynamic resolution, composition renders scene color at render extent, upscaled to swapchain before UI
+	bool mDynamicResolution = false;
+	uint32_t mFramesSinceScaling = 0; // smoothed frame time settles before next step
+	ImageParameters mSceneColor;
+	vk::UniqueRenderPass mSceneRenderpass;
+	vk::UniqueFramebuffer mSceneFramebuffer;
+
+	// depth prepass followed by G-buffer, composition and UI subpasses
+	CompositionMode mCompositionMode{}; // fragment
+	vk::UniqueRenderPass mDepthPrepassRenderpass;
+	vk::UniqueFramebuffer mDepthPrepassFramebuffer;
+	vk::UniqueRenderPass mMergedRenderpass;
+	std::vector<vk::UniqueFramebuffer> mMergedFramebuffers;
 
 	// uniform buffers
 	BufferParameters mObjectStagingBuffer;
@@ -101,6 +154,9 @@ private:
 	BufferParameters mCameraStagingBuffer;
 	BufferParameters mCameraUniformBuffer;
 	BufferParameters mDebugUniformBuffer;
+	BufferParameters mTiledStatsBuffer; // host visible copy of tiled light references, overflow and longest list
+	BufferParameters mClusterStatsBuffer; // host visible copy of unique cluster count, light references and page usage
+	BufferParameters mZBinStatsBuffer; // host visible copy of z-bin tile light references
 
 	// Lights buffer
 	BufferParameters mLightsBuffers;
@@ -108,10 +164,16 @@ private:
 	vk::DeviceSize mLightsOutOffset;
 	vk::DeviceSize mPointLightsOffset;
 	vk::DeviceSize mLightsOutSwapOffset;
+	vk::DeviceSize mLightVolumesOffset;
+	vk::DeviceSize mLightIntensitiesOffset;
+	vk::DeviceSize mLightSpotsOffset;
+	vk::DeviceSize mNodeLightsOffset;
 
 	vk::DeviceSize mLightsOutSize;
 	vk::DeviceSize mPointLightsSize;
 	vk::DeviceSize mLightsOutSwap;
+	vk::DeviceSize mPackedLightsSize; // size of each packed light stream
+	vk::DeviceSize mNodeLightsSize;
 
 	// Cluster buffer
 	BufferParameters mClusteredBuffer;
@@ -122,11 +184,46 @@ private:
 	vk::DeviceSize mPageTableSize;
 	vk::DeviceSize mPagePoolSize;
 	vk::DeviceSize mUniqueClustersSize;
+	vk::DeviceSize mClusterStatsOffset;
+	vk::DeviceSize mClusterStatsSize;
+
+	// z-binning, depth bins followed by light bitmasks of tiles
+	BufferParameters mZBinBuffer;
+	vk::DeviceSize mZBinMaskOffset;
+	vk::DeviceSize mZBinMaskSize = 0;
+	uint32_t mZBinLightCount = 0; // sorted lights fitting to tile masks, rest is dropped
+	uint32_t mZBinWordsPerTile = 0;
 	
 	glm::uvec2 mTileCount;
+	uint32_t mDepthSlices = 512; // cluster key has 9 bits of depth slice
+	glm::uvec2 mClusterKeyBits; // bits of tile x and y in cluster key
+	uint32_t mPageSizePower;
+	uint32_t mPageTableEntries;
+	uint32_t mPagePoolPages; // physical pages backing the page table
+	glm::vec2 mDepthBounds = { 0.0f, 0.0f }; // view depth of nearest and farthest pixel of previous frame
 	uint32_t mLightsCount;
 	uint32_t mCurrentTileSize = 32;
 	uint32_t mSubGroupSize;
+	bool mFragmentSubgroupArithmetic = false; // required by scalarized light loop
+	bool mVisibilityBufferSupported = false; // needs primitive ID in fragment shader and uniform material walk
+
+	// statistics of previous frame, read synchronously after general queue waits idle in updateLights
+	vk::UniqueQueryPool mStatisticsQueryPool;
+	uint64_t mGBufferVertexInvocations = 0;
+	uint64_t mGBufferTriangles = 0;
+	vk::UniqueQueryPool mTimestampQueryPool;
+	float mTimestampPeriod = 1.0f; // nanoseconds per tick
+	float mCompositionTime = 0.0f; // milliseconds, smoothed
+	float mDiffuseTime = 0.0f; // reduced resolution diffuse pass, included in composition time
+	float mFrameTime = 0.0f; // G-buffer begin to composition end, smoothed
+	uint32_t mTiledLightReferences = 0; // light indices in lists of all tiles
+	uint32_t mTiledOverflow = 0; // light indices dropped from tiled light lists
+	uint32_t mTiledMaxLights = 0;
+	uint32_t mUniqueClusterCount = 0;
+	uint32_t mClusterLightReferences = 0; // light indices in lists of all clusters
+	uint32_t mClusterMaxLights = 0;
+	uint32_t mClusterPageCount = 0; // physical pages allocated by page table
+	uint32_t mZBinLightReferences = 0; // light bits set in masks of all tiles
 	
 	// params for light culling created at light sorting
 	uint32_t mMaxBVHLevel;
@@ -36,24 +36,24 @@ vk::DescriptorSet DescriptorSet::add(const std::string& key, vk::DescriptorSetAl
 	return *mData.insert_or_assign(key, mDevice.allocateDescriptorSetsUnique(allocInfo)).first->second[0];
 }
 
-vk::ShaderModule ShaderModule::add(const std::string& key)
+vk::ShaderModule ShaderModule::add(const std::string& key, const std::string& defines)
 {
 	try
 	{
-		auto spirv = util::compileShader(key);
+		auto spirv = util::compileShader(key, defines);
 
 		vk::ShaderModuleCreateInfo shaderInfo;
 		shaderInfo.codeSize = spirv.size() * sizeof(uint32_t);
 		shaderInfo.pCode = spirv.data();
 
-		mData.insert_or_assign(key, mDevice.createShaderModuleUnique(shaderInfo));
+		mData.insert_or_assign(key + defines, mDevice.createShaderModuleUnique(shaderInfo));
 	}
 	catch (std::runtime_error& err)
 	{
 		std::cout << err.what() << std::endl;
 	}
 
-	return *mData[key];
+	return *mData[key + defines];
 }
 
 void Semaphore::add(const std::string& key, size_t count)
@@ -97,7 +97,7 @@ namespace resource
 	public:
 		explicit ShaderModule(const vk::Device device) : Base(device) {}
 
-		vk::ShaderModule add(const std::string& key);
+		vk::ShaderModule add(const std::string& key, const std::string& defines = ""); // variants are stored under key + defines
 	};
 
 	class Semaphore : public BaseVector<vk::UniqueSemaphore, vk::Semaphore>
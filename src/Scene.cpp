@@ -8,11 +8,11 @@
 #include "Scene.h"
 #include "Renderer.h"
 
-Scene::Scene(SceneConfig config, Renderer& renderer, ThreadPool& threadPool, GLFWwindow* window)
+Scene::Scene(SceneConfig config, Renderer& renderer, ThreadPool& threadPool, GLFWwindow* window, bool packedVertices)
 	: mCamera(window, config.camPosition, config.camRotation)
 	, mScale(config.scale)
 { 
-	mModel.loadModel(renderer.mContext, config.modelPath, *renderer.mSampler, *renderer.mDescriptorPool, renderer.mResource, threadPool);
+	mModel.loadModel(renderer.mContext, config.modelPath, *renderer.mSampler, *renderer.mDescriptorPool, renderer.mResource, threadPool, packedVertices);
 }
 
 void Scene::update(float dt)
@@ -30,9 +30,14 @@ glm::vec3 Scene::getScale() const
 	return mScale;
 }
 
-const std::vector<MeshPart>& Scene::getGeometry() const
+Model& Scene::getModel()
 {
-	return mModel.getMeshParts();
+	return mModel;
+}
+
+const Model& Scene::getModel() const
+{
+	return mModel;
 }
 
 const std::vector<SceneConfig> SceneConfigurations::data = 
@@ -27,7 +27,7 @@ struct SceneConfig
 class Scene
 {
 public:
-	Scene(SceneConfig config, Renderer& renderer, ThreadPool& threadPool, GLFWwindow* window);
+	Scene(SceneConfig config, Renderer& renderer, ThreadPool& threadPool, GLFWwindow* window, bool packedVertices);
 	
 	Scene() = default;
 	~Scene() = default;
@@ -41,7 +41,8 @@ public:
 
 	Camera& getCamera();
 	glm::vec3 getScale() const;
-	const std::vector<MeshPart>& getGeometry() const;
+	Model& getModel();
+	const Model& getModel() const;
 
 private:
 	Model mModel;
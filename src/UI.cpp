@@ -45,12 +45,83 @@ void UI::update()
 	{
 		Text("%.3f ms/frame (%.1f FPS)", 1000.0f / GetIO().Framerate, GetIO().Framerate);
 
+		Text("G-buffer triangles: %llu", static_cast<unsigned long long>(mRenderer.mGBufferTriangles));
+
+		if (mRenderer.mStatisticsQueryPool)
+			Text("G-buffer VS invocations: %llu", static_cast<unsigned long long>(mRenderer.mGBufferVertexInvocations));
+
+		if (mContext.cullingMethod == CullingMethod::tiled)
+		{
+			uint32_t tileCount = mRenderer.mTileCount.x * mRenderer.mTileCount.y;
+			Text("Tile light references: %u (%.1f per tile)", mRenderer.mTiledLightReferences, tileCount > 0 ? static_cast<float>(mRenderer.mTiledLightReferences) / tileCount : 0.0f);
+			Text("Max lights per tile: %u", mRenderer.mTiledMaxLights);
+			Text("Tiled list overflow: %u", mRenderer.mTiledOverflow);
+		}
+
+		if (mContext.cullingMethod == CullingMethod::zbin)
+		{
+			uint32_t tileCount = mRenderer.mTileCount.x * mRenderer.mTileCount.y;
+			Text("Tile light references: %u (%.1f per tile)", mRenderer.mZBinLightReferences, tileCount > 0 ? static_cast<float>(mRenderer.mZBinLightReferences) / tileCount : 0.0f);
+			Text("Z-bin dropped lights: %u", mRenderer.mLightsCount - std::min(mRenderer.mZBinLightCount, mRenderer.mLightsCount));
+		}
+
+		if (mContext.cullingMethod == CullingMethod::clustered)
+		{
+			float referencesPerCluster = mRenderer.mUniqueClusterCount > 0 ? static_cast<float>(mRenderer.mClusterLightReferences) / mRenderer.mUniqueClusterCount : 0.0f;
+			Text("Unique clusters: %u", mRenderer.mUniqueClusterCount);
+			Text("Cluster light references: %u (%.1f per cluster)", mRenderer.mClusterLightReferences, referencesPerCluster);
+			Text("Max lights per cluster: %u", mRenderer.mClusterMaxLights);
+			Text("Pages: %u / %u", mRenderer.mClusterPageCount, mRenderer.mPagePoolPages);
+
+			mSphereTestStats[static_cast<size_t>(mContext.clusterSphereTest)] = { referencesPerCluster, mRenderer.mCompositionTime };
+		}
+
+		if (mRenderer.mTimestampQueryPool && TreeNode("Profiler"))
+		{
+			Text("GPU frame: %.3f ms", mRenderer.mFrameTime);
+			Text(mRenderer.mCompositionMode == CompositionMode::subpass ? "Merged pass: %.3f ms" : "Composition: %.3f ms", mRenderer.mCompositionTime);
+
+			// reduced resolution diffuse pass is part of composition time
+			if (mRenderer.mDiffuseScale > 1)
+				Text("Diffuse 1/%u: %.3f ms, full resolution: %.3f ms", mRenderer.mDiffuseScale, mRenderer.mDiffuseTime, mRenderer.mCompositionTime - mRenderer.mDiffuseTime);
+
+			// latest smoothed time of both light loops per scene
+			mCompositionTimes.resize(SceneConfigurations::data.size());
+			mCompositionTimes[mContext.currentScene][mContext.scalarizedLightLoop] = mRenderer.mCompositionTime;
+
+			for (size_t i = 0; i < mCompositionTimes.size(); i++)
+			{
+				Text("%s: %.3f ms per fragment, %.3f ms scalarized", SceneConfigurations::data[i].sceneName.c_str(),
+					mCompositionTimes[i][0], mCompositionTimes[i][1]);
+			}
+
+			// latest values of each sphere test, current scene only
+			const char* sphereTests[] = { "Planes", "AABB", "Cone" };
+			for (size_t i = 0; i < mSphereTestStats.size(); i++)
+				Text("%s: %.1f lights per cluster, %.3f ms", sphereTests[i], mSphereTestStats[i][0], mSphereTestStats[i][1]);
+
+			TreePop();
+		}
+
 		DragInt("Number of lights", &mContext.lightsCount, 10, 1, MAX_LIGHTS);
 		
 		// v_max doesn't work properly, make sure it doesn't exceed
 		if (mContext.lightsCount > MAX_LIGHTS) mContext.lightsCount = MAX_LIGHTS;
 		
 		DragFloat("Lights speed", &mContext.lightSpeed, 0.1f, 0.f, 20.f);
+
+		// point only scenes compile spot cone tests and falloff out
+		float spotFraction = mContext.spotLightFraction;
+		if (SliderFloat("Spot lights", &mContext.spotLightFraction, 0.0f, 1.0f))
+		{
+			if ((spotFraction > 0.0f) != (mContext.spotLightFraction > 0.0f))
+				mContext.shaderReloadDirtyBit = true;
+
+			mContext.spotLightsDirtyBit = true;
+		}
+
+		if (mContext.spotLightFraction > 0.0f && SliderFloat("Spot angle", &mContext.spotAngle, 5.0f, 90.0f))
+			mContext.spotLightsDirtyBit = true;
 		
 		if (const char* options[] = { "16x16", "32x32", "64x64" }; Combo("Tile Size", &mContext.tileSize, options, IM_ARRAYSIZE(options)))
 			mContext.shaderReloadDirtyBit = true;
@@ -61,11 +132,115 @@ void UI::update()
 		Checkbox("V-Sync", &mContext.vSync);
 
 		if (Combo("Current scene", &mContext.currentScene, SceneConfigurations::nameGetter, nullptr, static_cast<int>(SceneConfigurations::data.size())))
+		{
+			mContext.sceneReload = true;
+			mSphereTestStats = {}; // current scene only
+		}
+
+		if (Checkbox("Packed vertices", &mContext.packedVertices))
 			mContext.sceneReload = true;
 
-		if (const char* options[] = { "Disabled culling (classic deferred)", "Tiled", "Clustered" }; Combo("Culling method", reinterpret_cast<int*>(&mContext.cullingMethod), options, IM_ARRAYSIZE(options)))
+		Checkbox("Mesh LOD", &mContext.meshLod);
+		if (mContext.meshLod)
+			SliderFloat("LOD error (px)", &mContext.lodErrorThreshold, 0.1f, 16.0f);
+
+		if (Checkbox("Meshlet culling", &mContext.meshletCulling))
+			mContext.shaderReloadDirtyBit = true;
+
+		if (Checkbox("Reconstruct position", &mContext.reconstructPosition))
+			mContext.shaderReloadDirtyBit = true;
+
+		if (mRenderer.mVisibilityBufferSupported && Checkbox("Visibility buffer", &mContext.visibilityBuffer))
+			mContext.shaderReloadDirtyBit = true;
+
+		if (Checkbox("Depth prepass", &mContext.depthPrepass))
+			mContext.shaderReloadDirtyBit = true;
+
+		if (const char* options[] = { "Fragment (separate passes)", "Subpass (merged pass)", "Compute (clustered only)" }; Combo("Composition", reinterpret_cast<int*>(&mContext.compositionMode), options, IM_ARRAYSIZE(options)))
+			mContext.shaderReloadDirtyBit = true;
+
+		if (Checkbox("Reversed depth", &mContext.reversedDepth))
+			mContext.shaderReloadDirtyBit = true;
+
+		if (Checkbox("Dynamic resolution", &mContext.dynamicResolution))
+			mContext.shaderReloadDirtyBit = true;
+
+		if (mContext.dynamicResolution)
+		{
+			SliderFloat("GPU frame target (ms)", &mContext.frameTimeTarget, 2.0f, 33.3f);
+			Text("Render scale: %.2f (%ux%u)", mRenderer.mRenderScale, mRenderer.mRenderExtent.width, mRenderer.mRenderExtent.height);
+		}
+
+		if (mRenderer.mFragmentSubgroupArithmetic && Checkbox("Scalarized light loop", &mContext.scalarizedLightLoop))
+			mContext.shaderReloadDirtyBit = true;
+
+		auto previousMethod = mContext.cullingMethod;
+		if (const char* options[] = { "Disabled culling (classic deferred)", "Tiled", "Clustered", "Z-binning", "Light volumes" }; Combo("Culling method", reinterpret_cast<int*>(&mContext.cullingMethod), options, IM_ARRAYSIZE(options)))
+		{
 			mContext.cullingMethodChanged = true;
 
+			// light volumes attach G-buffer depth to composition pass
+			if (previousMethod == CullingMethod::lightVolumes || mContext.cullingMethod == CullingMethod::lightVolumes)
+				mContext.shaderReloadDirtyBit = true;
+
+			// light volumes shade each light in its own draw, there is no per pixel light count
+			if (mContext.cullingMethod == CullingMethod::lightVolumes && mContext.debugState == DebugStates::lightCount)
+			{
+				mContext.debugState = DebugStates::disabled;
+				mContext.debugUniformDirtyBit = true;
+			}
+
+			// diffuse targets follow resolution of selected method
+			if (mContext.diffuseResolution[static_cast<size_t>(previousMethod)] != mContext.diffuseResolution[static_cast<size_t>(mContext.cullingMethod)])
+				mContext.shaderReloadDirtyBit = true;
+		}
+
+		if (mContext.compositionMode == CompositionMode::fragment && mContext.cullingMethod != CullingMethod::lightVolumes)
+		{
+			auto& resolution = mContext.diffuseResolution[static_cast<size_t>(mContext.cullingMethod)];
+			if (const char* options[] = { "Full", "Half", "Quarter" }; Combo("Diffuse resolution", reinterpret_cast<int*>(&resolution), options, IM_ARRAYSIZE(options)))
+				mContext.shaderReloadDirtyBit = true;
+		}
+
+		if (TreeNode("Camera"))
+		{
+			auto& camera = mRenderer.mScene.getCamera();
+			float fov = glm::degrees(camera.getFov());
+			float zNear = camera.getNear();
+			float zFar = camera.getFar();
+
+			bool changed = SliderFloat("FOV", &fov, 20.0f, 120.0f);
+			changed |= DragFloat("Near", &zNear, 0.005f, 0.01f, 10.0f);
+			changed |= DragFloat("Far", &zFar, 1.0f, 10.0f, 10000.0f);
+
+			if (changed)
+				camera.setPerspective(glm::radians(fov), zNear, zFar);
+
+			TreePop();
+		}
+
+		if (mContext.cullingMethod == CullingMethod::clustered)
+		{
+			// slices are updated in camera ubo every frame, no reload needed
+			const char* slicings[] = { "Camera near/far", "Depth bounds", "Scene bounds" };
+			Combo("Depth slicing", reinterpret_cast<int*>(&mContext.depthSlicing), slicings, IM_ARRAYSIZE(slicings));
+
+			if (const char* options[] = { "Planes", "Planes and AABB", "Cone" }; Combo("Cluster sphere test", reinterpret_cast<int*>(&mContext.clusterSphereTest), options, IM_ARRAYSIZE(options)))
+				mContext.shaderReloadDirtyBit = true;
+
+			if (Checkbox("Light LOD", &mContext.lightLod))
+				mContext.shaderReloadDirtyBit = true;
+
+			if (mContext.lightLod)
+				SliderFloat("LOD error bound", &mContext.lightLodThreshold, 0.01f, 1.0f);
+		}
+
+		if (mContext.cullingMethod == CullingMethod::tiled)
+		{
+			if (const char* options[] = { "Min/max", "HalfZ", "2.5D" }; Combo("Tiled depth", reinterpret_cast<int*>(&mContext.tiledDepthMode), options, IM_ARRAYSIZE(options)))
+				mContext.shaderReloadDirtyBit = true;
+		}
+
 		if (TreeNode("Light extents"))
 		{
 			DragFloat3("Min", reinterpret_cast<float*>(&mContext.lightBoundMin), 0.25);
@@ -76,13 +251,26 @@ void UI::update()
 
 		if (TreeNode("Render texture"))
 		{
-			const auto names = { "Default", "Albedo", "Normal", "Specular", "Position", "Depth" };
+			const auto names = { "Default", "Albedo", "Normal", "Specular", "Position", "Depth", "Light count" };
 
 			for (size_t i = 0; i < static_cast<size_t>(DebugStates::count); i++)
 			{
-				if (Selectable(*(names.begin() + i), static_cast<DebugStates>(i) == mContext.debugState))
+				auto state = static_cast<DebugStates>(i);
+
+				// transient G-buffer of merged pass cannot be displayed
+				if (mContext.compositionMode == CompositionMode::subpass && state != DebugStates::disabled && state != DebugStates::lightCount)
+					continue;
+
+				if (mContext.cullingMethod == CullingMethod::lightVolumes && state == DebugStates::lightCount)
+					continue;
+
+				if (Selectable(*(names.begin() + i), state == mContext.debugState))
 				{
-					mContext.debugState = static_cast<DebugStates>(i);
+					// heatmap is compiled into composition shaders
+					if (state == DebugStates::lightCount || mContext.debugState == DebugStates::lightCount)
+						mContext.shaderReloadDirtyBit = true;
+
+					mContext.debugState = state;
 					mContext.debugUniformDirtyBit = true;
 				}
 			}
@@ -413,8 +601,8 @@ void UI::createPipeline()
 	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &blendingInfo;
 	pipelineInfo.layout = layout;
-	pipelineInfo.renderPass = *mRenderer.mCompositionRenderpass;
-	pipelineInfo.subpass = 1;
+	pipelineInfo.renderPass = mRenderer.mCompositionMode == CompositionMode::subpass ? *mRenderer.mMergedRenderpass : *mRenderer.mCompositionRenderpass;
+	pipelineInfo.subpass = mRenderer.mCompositionMode == CompositionMode::subpass ? 2 : 1; // UI is last subpass
 	pipelineInfo.basePipelineHandle = mRenderer.mResource.pipeline.get("composition"); // derive from composition pipeline
 	pipelineInfo.basePipelineIndex = -1;
 
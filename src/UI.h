@@ -7,6 +7,7 @@
 
 #pragma once
 #include <string>
+#include <array>
 #include "Util.h"
 #include "Scene.h"
 
@@ -21,6 +22,7 @@ enum class DebugStates : unsigned
 	specular,
 	position,
 	depth,
+	lightCount, // heatmap of lights evaluated by composition
 
 	count
 };
@@ -30,6 +32,43 @@ enum class CullingMethod : int
 	noculling,
 	tiled,
 	clustered,
+	zbin, // depth bins of sorted lights intersected with tile bitmasks
+	lightVolumes, // instanced light spheres depth tested against G-buffer, blended additively
+};
+
+enum class CompositionMode : int
+{
+	fragment, // separate G-buffer and composition render passes
+	subpass, // depth prepass, then G-buffer and composition merged into one render pass
+	compute, // clustered composition in compute shader, shades from lights shared by workgroup
+};
+
+enum class TiledDepthMode : int
+{
+	minMax, // single depth range per tile
+	halfZ, // tile depth split into near and far range at half of min/max
+	depthMask, // 2.5D, 32 slice occupancy mask of tile depth
+};
+
+enum class ClusterSphereTest : int
+{
+	planes, // six frustum planes, false positives near cluster corners
+	aabb, // planes and view space AABB of cluster
+	cone, // cone bounding cluster, cut by near and far plane
+};
+
+enum class DepthSlicing : int
+{
+	camera, // exponential slices between near and far plane
+	depthBounds, // nearest and farthest pixel of previous frame
+	sceneBounds, // view depth of scene bounding spheres
+};
+
+enum class DiffuseResolution : int
+{
+	full,
+	half, // diffuse lighting of one sample per 2x2 block, upsampled by composition
+	quarter, // one sample per 4x4 block
 };
 
 enum class WindowSize : unsigned
@@ -47,6 +86,10 @@ public:
 	{
 		DebugStates debugState = DebugStates::disabled;
 		CullingMethod cullingMethod = CullingMethod::clustered;
+		CompositionMode compositionMode = CompositionMode::fragment;
+		TiledDepthMode tiledDepthMode = TiledDepthMode::minMax;
+		ClusterSphereTest clusterSphereTest = ClusterSphereTest::planes;
+		DepthSlicing depthSlicing = DepthSlicing::camera;
 		WindowSize windowSize = WindowSize::_1920x1080;
 		bool debugUniformDirtyBit = false;
 		bool shaderReloadDirtyBit = false;
@@ -57,9 +100,26 @@ public:
 		glm::vec3 lightBoundMax;
 		int lightsCount = 10;
 		float lightSpeed = 0.f;
+		float spotLightFraction = 0.0f; // share of lights turned to spot lights
+		float spotAngle = 30.0f; // half angle in degrees
+		bool spotLightsDirtyBit = false;
 		int tileSize = 1;
 		int currentScene = 0;
 		bool vSync = false;
+		bool packedVertices = false;
+		bool meshLod = false;
+		float lodErrorThreshold = 1.0f; // in pixels
+		bool meshletCulling = false;
+		bool reconstructPosition = false; // drops position G-buffer target
+		bool visibilityBuffer = false; // G-buffer resolved from rasterized triangle IDs, not in merged pass
+		bool depthPrepass = false; // position only depth pass, light culling overlaps G-buffer shading
+		bool reversedDepth = false; // float depth cleared to zero, infinite far plane
+		bool dynamicResolution = false; // G-buffer and lighting scaled to hold GPU frame time, fragment composition only
+		float frameTimeTarget = 16.7f; // ms
+		std::array<DiffuseResolution, static_cast<size_t>(CullingMethod::lightVolumes) + 1> diffuseResolution{}; // per culling method, fragment composition only
+		bool scalarizedLightLoop = false; // clustered composition walks clusters of subgroup uniformly
+		bool lightLod = false; // distant BVH nodes are shaded as one merged light
+		float lightLodThreshold = 0.1f; // max size of merged node relative to its distance from cluster
 	} mContext;
 
 public:
@@ -87,4 +147,7 @@ private:
 
 	ImageParameters mFontTexture;
 	vk::UniqueSampler mSampler;
+
+	std::vector<std::array<float, 2>> mCompositionTimes; // per scene, per fragment and scalarized light loop
+	std::array<std::array<float, 2>, 3> mSphereTestStats{}; // per cluster sphere test, light references per cluster and composition time
 };
\ No newline at end of file
@@ -23,6 +23,19 @@
 
 namespace
 {
+	bool hasMemoryType(uint32_t typeFilter, const vk::MemoryPropertyFlags& properties, vk::PhysicalDevice physicalDevice)
+	{
+		auto memoryProperties = physicalDevice.getMemoryProperties();
+
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeFilter & (1 << i)) != 0 && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+				return true;
+		}
+
+		return false;
+	}
+
 	uint32_t findMemoryType(uint32_t typeFilter, const vk::MemoryPropertyFlags& properties, vk::PhysicalDevice physicalDevice)
 	{
 		auto memoryProperties = physicalDevice.getMemoryProperties();
@@ -99,8 +112,55 @@ std::array<vk::VertexInputAttributeDescription, 5> util::getVertexAttributeDescr
 	return descriptions;
 }
 
+vk::VertexInputBindingDescription util::getPackedVertexBindingDescription()
+{
+	vk::VertexInputBindingDescription bindingDescription;
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(PackedVertex);
+	bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+	return bindingDescription;
+}
+
+std::array<vk::VertexInputAttributeDescription, 3> util::getPackedVertexAttributeDescriptions()
+{
+	std::array<vk::VertexInputAttributeDescription, 3> descriptions;
+	descriptions[0].binding = 0;
+	descriptions[0].location = 0;
+	descriptions[0].format = vk::Format::eR16G16B16A16Uint; // position and sign with color
+	descriptions[0].offset = offsetof(PackedVertex, pos);
+	descriptions[1].binding = 0;
+	descriptions[1].location = 1;
+	descriptions[1].format = vk::Format::eR16G16Sfloat;
+	descriptions[1].offset = offsetof(PackedVertex, texCoord);
+	descriptions[2].binding = 0;
+	descriptions[2].location = 2;
+	descriptions[2].format = vk::Format::eR16G16B16A16Snorm; // normal and tangent
+	descriptions[2].offset = offsetof(PackedVertex, normal);
+
+	return descriptions;
+}
+
+vk::VertexInputBindingDescription util::getPositionBindingDescription(bool packed)
+{
+	vk::VertexInputBindingDescription bindingDescription;
+	bindingDescription.binding = 0;
+	bindingDescription.stride = packed ? 4 * sizeof(uint16_t) : sizeof(glm::vec3); // packed keeps sign and color word
+	bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+	return bindingDescription;
+}
+
+vk::VertexInputAttributeDescription util::getPositionAttributeDescription(bool packed)
+{
+	vk::VertexInputAttributeDescription description;
+	description.binding = 0;
+	description.location = 0;
+	description.format = packed ? vk::Format::eR16G16B16A16Uint : vk::Format::eR32G32B32Sfloat;
+	description.offset = 0;
+	return description;
+}
+
 #include "ShaderResourceConfig.inl"
-std::vector<uint32_t> util::compileShader(const std::string& filename)
+std::vector<uint32_t> util::compileShader(const std::string& filename, const std::string& defines)
 {
 	static bool initDummy = glslang::InitializeProcess();
 
@@ -116,6 +176,7 @@ std::vector<uint32_t> util::compileShader(const std::string& filename)
 
 	glslang::TShader shader(shaderType);
 	shader.setStrings(&inputString, 1);
+	shader.setPreamble(defines.c_str());
 	shader.setEnvInput(glslang::EShSourceGlsl, shaderType, glslang::EShClientVulkan, 100);
 	shader.setEnvClient(glslang::EShClientVulkan, glslang::EshTargetClientVersion::EShTargetVulkan_1_1);
 	shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetLanguageVersion::EShTargetSpv_1_3);
@@ -215,13 +276,13 @@ vk::WriteDescriptorSet util::createDescriptorWriteBuffer(vk::DescriptorSet targe
 	return writeDescriptor;
 }
 
-vk::WriteDescriptorSet util::createDescriptorWriteImage(vk::DescriptorSet target, uint32_t binding, vk::DescriptorImageInfo& imageInfo)
+vk::WriteDescriptorSet util::createDescriptorWriteImage(vk::DescriptorSet target, uint32_t binding, vk::DescriptorImageInfo& imageInfo, vk::DescriptorType type)
 {
 	vk::WriteDescriptorSet writeDescriptor;
 	writeDescriptor.dstSet = target;
 	writeDescriptor.dstBinding = binding;
 	writeDescriptor.descriptorCount = 1;
-	writeDescriptor.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+	writeDescriptor.descriptorType = type;
 	writeDescriptor.pImageInfo = &imageInfo;
 
 	return writeDescriptor;
@@ -341,6 +402,10 @@ ImageParameters Utility::createImage(uint32_t width, uint32_t height, vk::Format
 	// allocate image memory
 	auto memoryReq = mContext.getDevice().getImageMemoryRequirements(*image);
 
+	// lazily allocated memory is a preference, dropped when no memory type allowed for image has it
+	if ((memProperties & vk::MemoryPropertyFlagBits::eLazilyAllocated) && !hasMemoryType(memoryReq.memoryTypeBits, memProperties, mContext.getPhysicalDevice()))
+		memProperties &= ~vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eLazilyAllocated);
+
 	vk::MemoryAllocateInfo allocInfo;
 	allocInfo.allocationSize = memoryReq.size;
 	allocInfo.memoryTypeIndex = findMemoryType(memoryReq.memoryTypeBits, memProperties, mContext.getPhysicalDevice());
@@ -49,6 +49,7 @@ struct GBuffer
 	ImageParameters position;
 	ImageParameters color;
 	ImageParameters normal;
+	ImageParameters visibility; // triangle IDs, only in visibility buffer mode
 };
 
 namespace util
@@ -69,6 +70,15 @@ namespace util
 		size_t hash() const;
 	};
 
+	struct PackedVertex // 20 bytes, baked by mesh::packVertices
+	{
+		uint16_t pos[3]; // unorm relative to part bounds
+		uint16_t signColor; // bitangent sign in highest bit, RGB555 color
+		uint32_t texCoord; // 2x half float
+		uint32_t normal; // octahedral 2x snorm16
+		uint32_t tangent; // octahedral 2x snorm16
+	};
+
 	namespace init
 	{
 		// vk::WriteDescriptorSet writeDescriptorSet(vk::DescriptorSet target, )
@@ -76,9 +86,13 @@ namespace util
 
 	vk::VertexInputBindingDescription getVertexBindingDesciption();
 	std::array<vk::VertexInputAttributeDescription, 5> getVertexAttributeDescriptions();
-	std::vector<uint32_t> compileShader(const std::string& filename);
+	vk::VertexInputBindingDescription getPackedVertexBindingDescription();
+	std::array<vk::VertexInputAttributeDescription, 3> getPackedVertexAttributeDescriptions();
+	vk::VertexInputBindingDescription getPositionBindingDescription(bool packed); // position only stream of depth prepass
+	vk::VertexInputAttributeDescription getPositionAttributeDescription(bool packed);
+	std::vector<uint32_t> compileShader(const std::string& filename, const std::string& defines = ""); // defines are passed as preamble
 	vk::WriteDescriptorSet createDescriptorWriteBuffer(vk::DescriptorSet target, uint32_t binding, vk::DescriptorType type, vk::DescriptorBufferInfo& bufferInfo);
-	vk::WriteDescriptorSet createDescriptorWriteImage(vk::DescriptorSet target, uint32_t binding, vk::DescriptorImageInfo& imageInfo);
+	vk::WriteDescriptorSet createDescriptorWriteImage(vk::DescriptorSet target, uint32_t binding, vk::DescriptorImageInfo& imageInfo, vk::DescriptorType type = vk::DescriptorType::eCombinedImageSampler);
 }
 
 class Utility // TODO make it singleton (all functions in namespace using singleton, who owns device context etc.)